@@ -0,0 +1,133 @@
+// alloc-bench.cpp - Decoder Allocation Benchmark
+//
+// Streams a 16-bit mono wav file in small chunks through one decoder,
+// utterance after utterance (the way a pooled decoder serves bidi streams),
+// and counts the heap allocations made while decoding and while getting the
+// results. The counts come from an interposed global `operator new`, so they
+// cover kaldi and openfst as well as kaldiserve.
+//
+// Usage: alloc-bench <model-spec-toml> <wav-path> [chunk-secs] [utterances]
+
+// stl includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// local includes
+#include "config.hpp"
+#include "decoder.hpp"
+#include "types.hpp"
+#include "utils.hpp"
+
+
+static std::atomic<std::size_t> n_allocs(0);
+static std::atomic<std::size_t> n_alloc_bytes(0);
+
+void *operator new(std::size_t size) {
+    n_allocs++;
+    n_alloc_bytes += size;
+    if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: alloc-bench <model-spec-toml> <wav-path> [chunk-secs] [utterances]" << ENDL;
+        return 1;
+    }
+    const float chunk_secs = argc > 3 ? std::stof(argv[3]) : 0.1f;
+    const int n_utterances = argc > 4 ? std::stoi(argv[4]) : 10;
+
+    std::vector<kaldiserve::ModelSpec> model_specs;
+    kaldiserve::parse_model_specs(argv[1], model_specs);
+    if (model_specs.empty()) {
+        std::cout << "no models in " << argv[1] << ENDL;
+        return 1;
+    }
+
+    // header and audio data of the file, the data is streamed in chunks
+    std::ifstream wav_file(argv[2], std::ios::binary);
+    const std::string wav((std::istreambuf_iterator<char>(wav_file)), std::istreambuf_iterator<char>());
+    std::size_t header_size = 0, chunk_bytes = 0;
+    {
+        std::stringstream wav_stream(wav);
+        kaldi::WaveInfo wave_info;
+        wave_info.Read(wav_stream);
+        if (wave_info.NumChannels() != 1) {
+            std::cout << "expected mono audio" << ENDL;
+            return 1;
+        }
+        header_size = std::size_t(wav_stream.tellg());
+        chunk_bytes = std::max<std::size_t>(1, std::size_t(chunk_secs * wave_info.SampFreq())) * wave_info.BlockAlign();
+    }
+
+    kaldiserve::DecoderFactory decoder_factory(model_specs.front());
+    std::unique_ptr<kaldiserve::Decoder> decoder(decoder_factory.produce());
+
+    for (int u = 0; u < n_utterances; u++) {
+        std::size_t decode_allocs = 0, result_allocs = 0, decode_bytes = 0;
+        std::size_t n_chunks = 0;
+        const auto start = std::chrono::steady_clock::now();
+
+        decoder->start_decoding("alloc-bench");
+        decoder->decode_stream_wav_chunk(wav.data(), header_size);
+        for (std::size_t offset = header_size; offset < wav.size(); offset += chunk_bytes) {
+            const std::size_t size = std::min(chunk_bytes, wav.size() - offset);
+
+            std::size_t allocs = n_allocs, bytes = n_alloc_bytes;
+            decoder->decode_stream_wav_chunk(wav.data() + offset, size);
+            decode_allocs += n_allocs - allocs;
+            decode_bytes += n_alloc_bytes - bytes;
+
+            kaldiserve::utterance_results_t results;
+            allocs = n_allocs;
+            decoder->get_decoded_results(1, results, false, true);
+            result_allocs += n_allocs - allocs;
+            n_chunks++;
+        }
+
+        kaldiserve::utterance_results_t results;
+        std::size_t allocs = n_allocs;
+        decoder->get_decoded_results(10, results);
+        const std::size_t final_allocs = n_allocs - allocs;
+        decoder->free_decoder();
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "utterance " << u << ": " << n_chunks << " chunks in " << elapsed.count() << "s, "
+                  << "decoding " << decode_allocs / n_chunks << " allocs (" << decode_bytes / n_chunks << " bytes) per chunk, "
+                  << "partial results " << result_allocs / n_chunks << " allocs per chunk, "
+                  << "final 10-best " << final_allocs << " allocs" << ENDL;
+    }
+
+    return 0;
+}
\ No newline at end of file
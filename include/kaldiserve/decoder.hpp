@@ -2,12 +2,18 @@
 #pragma once
 
 // stl includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <memory>
 #include <mutex>
 #include <queue>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 // kaldi includes
@@ -33,10 +39,14 @@
 #include "types.hpp"
 #include "model.hpp"
 #include "utils.hpp"
+#include "wav.hpp"
 
 
 namespace kaldiserve {
 
+class WorkerPool;
+class SharedFrontend;
+
 // Forward declare class for friendship (hack for now)
 class ChainModel;
 
@@ -51,6 +61,10 @@ class Decoder final {
     // SETUP METHODS
     void start_decoding(const std::string &uuid="") noexcept;
 
+    // starts decoding an utterance whose features come from a shared frontend
+    // (see `SharedFrontend`, which feeds the audio and advances the decoder)
+    void start_decoding(const std::string &uuid, SharedFrontend *const frontend);
+
     void free_decoder() noexcept;
 
     // STREAMING METHODS
@@ -58,6 +72,11 @@ class Decoder final {
     // decode an intermediate frame/chunk of a wav audio stream
     void decode_stream_wav_chunk(std::istream &wav_stream);
 
+    // decode an intermediate chunk of a wav audio stream held in memory
+    // (only the first chunk needs the wav header, later chunks may carry
+    // just the audio data in the stream's format)
+    void decode_stream_wav_chunk(const char *data, const std::size_t &size);
+
     // decode an intermediate frame/chunk of a raw headerless wav audio stream
     void decode_stream_raw_wav_chunk(std::istream &wav_stream,
                                      const float &samp_freq,
@@ -77,21 +96,130 @@ class Decoder final {
                               const int &data_bytes,
                               const float &chunk_size=1);
 
+    // decodes (independent) audio samples
+    // internally chunks the audio and decodes them
+    // (chunk size in seconds, a non-positive value decodes all of it at once)
+    void decode_audio(const kaldi::VectorBase<kaldi::BaseFloat> &audio,
+                      const float &samp_freq,
+                      const float &chunk_size=1);
+
+    // advances the search over the frames a shared frontend has made ready
+    // for a chunk of `chunk_secs` audio
+    void decode_shared_chunk(const kaldi::BaseFloat &chunk_secs);
+
     // LATTICE DECODING METHODS
 
     // get the final utterances based on the compact lattice
+    // (`stable_words` marks the stable prefix of bidi partials, which takes
+    // a determinization of the raw lattice)
     void get_decoded_results(const int &n_best,
                              utterance_results_t &results,
                              const bool &word_level=false,
-                             const bool &bidi_streaming=false);
+                             const bool &bidi_streaming=false,
+                             const bool &stable_words=false);
+
+    // CANCELLATION METHODS
+    // decoding of an interrupted utterance stops early, the results
+    // are then based on the frames decoded so far.
+
+    // interrupts decoding of the current utterance (thread-safe)
+    void cancel() noexcept;
+
+    // interrupts decoding of the current utterance once the deadline has passed
+    void set_deadline(const std::chrono::system_clock::time_point &deadline) noexcept;
+
+    // interrupts decoding of the current utterance once the check returns true
+    // (polled in between chunks and decoding quanta)
+    void set_cancel_check(const std::function<bool()> &cancel_check) noexcept;
+
+    // tells whether decoding of the current utterance has been interrupted
+    bool cancelled() noexcept;
+
+    // clears the interruption (and the deadline and cancel check) of the
+    // current utterance so that it can be continued, e.g. on a resumed stream
+    void clear_interruption() noexcept;
+
+    // SCORING METHODS
+
+    // average log-likelihood per decoded frame of the current best path (graph
+    // and scaled acoustic scores), for comparing models on the same audio
+    // (-inf before any frame is decoded)
+    kaldi::BaseFloat best_path_score();
+
+    // no. of stream bytes taken in by the streaming methods for the current utterance
+    inline std::size_t processed_bytes() const noexcept {
+        return processed_bytes_;
+    }
+
+    // SNAPSHOT METHODS
+    // a snapshot is a replay journal of the utterance: the audio (and chunking)
+    // it was decoded from, along with the stream's format. restoring replays it
+    // on a decoder of the same model, which reproduces the feature pipeline,
+    // i-vector and search state exactly. both grow with the utterance: the
+    // journal takes 2 bytes per 16-bit sample (~115MB for an hour at 16kHz)
+    // and restoring re-decodes the whole utterance so far. (kaldi's search
+    // can't be resumed from a lattice, nor the looped nnet's state written,
+    // so there is no constant size state to capture instead.)
+    // needs `enable_snapshots` in the spec.
+
+    // writes the current utterance's replay journal as a (kaldi binary) blob
+    void snapshot(std::ostream &os) const;
+
+    // continues the utterance of a snapshot (replacing the current one) by
+    // re-decoding its journal, O(utterance length)
+    void restore(std::istream &is);
+
+    // sampling frequency (Hz) the model's features are computed at
+    inline float samp_freq() const noexcept {
+        return model_->samp_freq;
+    }
+
+    inline const ModelSpec &model_spec() const noexcept {
+        return model_->model_spec;
+    }
+
+    inline const kaldi::OnlineNnet2FeaturePipelineInfo &feature_info() const noexcept {
+        return *model_->feature_info;
+    }
+
+    // NUMA node of the model replica this decoder runs on (-1 if not placed)
+    inline int numa_node() const noexcept {
+        return model_->numa_node;
+    }
+
+    // STATISTICS METHODS
+    // running totals over the decoder's lifetime (all utterances)
+
+    // secs of audio taken in
+    inline double audio_secs() const noexcept {
+        return audio_secs_;
+    }
+
+    // secs spent decoding (feature extraction and search)
+    inline double decoding_secs() const noexcept {
+        return decoding_secs_;
+    }
 
     DecoderOptions options{false, false};
 
   private:
-    // decodes an intermediate wavepart
+    // decodes an intermediate wavepart (`pcm16` tells that its samples are
+    // 16-bit integers, which the replay journal keeps in 2 bytes)
     void _decode_wave(kaldi::SubVector<kaldi::BaseFloat> &wave_part,
                       std::vector<std::pair<int32, kaldi::BaseFloat>> &delta_weights,
-                      const kaldi::BaseFloat &samp_freq);
+                      const kaldi::BaseFloat &samp_freq,
+                      const bool &pcm16);
+
+    // appends a chunk to the utterance's replay journal (for snapshots)
+    void _record_audio(const kaldi::VectorBase<kaldi::BaseFloat> &wave_part,
+                       const kaldi::BaseFloat &samp_freq,
+                       const bool &pcm16);
+
+    // updates the i-vector silence weights from the current traceback
+    void _update_silence_weights(std::vector<std::pair<int32, kaldi::BaseFloat>> &delta_weights);
+
+    // advances the search over the frames ready so far
+    void _advance_decoding();
 
     // gets the final decoded transcripts from lattice
     void _find_alternatives(kaldi::CompactLattice &clat,
@@ -99,17 +227,62 @@ class Decoder final {
                             utterance_results_t &results,
                             const bool &word_level) const;
 
+    // no. of leading words shared by all the paths of a raw (partial) lattice
+    int32 _stable_words(const kaldi::Lattice &raw_lat) const;
+
+    void _get_lattice(const bool &end_of_utterance,
+                      kaldi::CompactLattice &clat) const;
+
     // model vars
     ChainModel *model_;
 
+    // scratch buffers (per decoder)
+    // reused by every chunk and utterance, cleared (not shrunk) when the
+    // decoder is freed so steady state decoding does not hit the allocator.
+    std::vector<char> wav_bytes_;
+    std::vector<kaldi::BaseFloat> wav_samples_;
+    std::vector<std::pair<int32, kaldi::BaseFloat>> delta_weights_;
+    // wav stream format (parsed from the first chunk's header)
+    WavStreamParser wav_parser_;
+
+    // decoder vars (persistent across utterances)
+    // the lattice search keeps its token hash and active token lists
+    // allocated between utterances, `InitDecoding` only resets them.
+    kaldi::LatticeFasterOnlineDecoder *decoder_;
+
     // decoder vars (per utterance)
-    kaldi::SingleUtteranceNnet3Decoder *decoder_;
+    // kaldi can't rewind these to a fresh utterance: the pipeline's features
+    // only grow (and end with `InputFinished`) and the decodable's nnet
+    // computer, whose matrices are the nnet workspace, is private to it and
+    // bound to the pipeline's features. so they (and that workspace) are
+    // created for every utterance.
+    kaldi::nnet3::DecodableAmNnetLoopedOnline *decodable_;
     kaldi::OnlineNnet2FeaturePipeline *feature_pipeline_;
     kaldi::OnlineSilenceWeighting *silence_weighting_;
     kaldi::OnlineIvectorExtractorAdaptationState *adaptation_state_;
 
+    // min. no. of new (output) frames for advancing the search
+    int32 advance_frames_;
+    // samples accepted since the last silence weighting update
+    int32 samples_since_weighting_;
+
     // req-specific vars
     std::string uuid_;
+    std::atomic<bool> cancelled_;
+    std::chrono::system_clock::time_point deadline_;
+    std::function<bool()> cancel_check_;
+    std::size_t processed_bytes_;
+
+    // replay journal of the current utterance (for snapshots). kept as 16-bit
+    // pcm unless a chunk of other samples comes along.
+    std::vector<int16> pcm_history_;
+    std::vector<kaldi::BaseFloat> float_history_;
+    std::vector<int32> chunk_history_;
+    kaldi::BaseFloat history_samp_freq_;
+
+    // decoder statistics (lifetime totals)
+    double audio_secs_;
+    double decoding_secs_;
 };
 
 
@@ -122,8 +295,9 @@ class DecoderFactory final {
 
     explicit DecoderFactory(const ModelSpec &model_spec);
 
-    inline Decoder *produce() const {
-        return new Decoder(model_.get());
+    // produces a decoder sharing the given model replica
+    inline Decoder *produce(const std::size_t &replica = 0) const {
+        return new Decoder(models_[replica].get());
     }
 
     // friendly alias for the producer method
@@ -131,8 +305,14 @@ class DecoderFactory final {
         return produce();
     }
 
+    // no. of model replicas (one per NUMA node when replicating)
+    inline std::size_t n_replicas() const noexcept {
+        return models_.size();
+    }
+
   private:
-    std::unique_ptr<ChainModel> model_;
+    // model replicas (replica `i` is placed on NUMA node `i` when replicating)
+    std::vector<std::unique_ptr<ChainModel>> models_;
 };
 
 
@@ -150,8 +330,17 @@ class DecoderQueue final {
     ~DecoderQueue();
 
     // friendly alias for `pop`
-    inline Decoder *acquire() {
-        return pop_();
+    // waiting requests of a higher priority class are served first
+    inline Decoder *acquire(const Priority &priority = REALTIME) {
+        return pop_(priority);
+    }
+
+    // acquires `n` decoders at once (e.g. one per audio channel), waiting
+    // until all of them are free so that no partial set is held meanwhile
+    inline void acquire(const std::size_t &n,
+                        std::vector<Decoder*> &decoders,
+                        const Priority &priority = REALTIME) {
+        return pop_(n, decoders, priority);
     }
 
     // friendly alias for `push`
@@ -159,6 +348,32 @@ class DecoderQueue final {
         return push_(decoder);
     }
 
+    // decodes a batch of `n_items` independent utterances in parallel, the
+    // decoders being acquired once for the whole batch (not per utterance).
+    // `decode(i, decoder)` runs the whole utterance `i` (from `start_decoding`
+    // to its results) and the decoder is freed after it. utterances run on the
+    // worker pool if given (else on threads of their own), errors raised by
+    // `decode` are rethrown once all the utterances are done.
+    void decode_batch(const std::size_t &n_items,
+                      const std::function<void(const std::size_t &, Decoder *const)> &decode,
+                      WorkerPool *const worker_pool = nullptr,
+                      const Priority &priority = BATCH);
+
+    // total no. of decoders owned by the queue
+    inline std::size_t n_decoders() const noexcept {
+        return n_decoders_;
+    }
+
+    // default chunk size (secs) for non-streaming decoding with this model,
+    // measured during warm-up when the model spec asks for auto tuning
+    inline float chunk_size() const noexcept {
+        return chunk_size_;
+    }
+
+    // current load of the queue: free and waited for decoders along with
+    // the expected wait and the recent real time factor (thread-safe)
+    QueueStatus status() const;
+
   private:
     // Push method that supports multi-threaded thread-safe concurrency
     // pushes a decoder object onto the queue
@@ -166,19 +381,104 @@ class DecoderQueue final {
 
     // Pop method that supports multi-threaded thread-safe concurrency
     // pops a decoder object from the queue
-    Decoder *pop_();
+    Decoder *pop_(const Priority &priority);
+
+    // pops `n` decoder objects from the queue in one go
+    void pop_(const std::size_t &n, std::vector<Decoder*> &items, const Priority &priority);
 
-    // underlying STL "unsafe" queue for storing decoder objects
-    std::queue<Decoder*> queue_;
+    // Decodes warm-up audio with a few chunk sizes and returns the one
+    // with the highest throughput
+    float tune_chunk_size_();
+
+    // underlying STL "unsafe" queues for storing decoder objects
+    // (one per model replica, i.e. per NUMA node when replicating)
+    std::vector<std::queue<Decoder*>> queues_;
     // custom mutex to make queue "thread-safe"
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
     // helper for holding mutex and notification on waiting threads when concerned resources are available
     std::condition_variable cond_;
+    // usage of the decoders handed out (for `status`), kept as moving averages
+    // of how long a decoder is held and of the real time factor it decoded at
+    struct Lease {
+        std::chrono::steady_clock::time_point acquired;
+        double audio_secs, decoding_secs;
+    };
+    std::unordered_map<Decoder*, Lease> leases_;
+    double avg_hold_secs_;
+    double avg_rtf_;
+    // default chunk size (secs) for non-streaming decoding with this model
+    float chunk_size_;
+    // total no. of decoders owned by the queue
+    std::size_t n_decoders_;
+    // no. of threads waiting for a decoder (per priority class)
+    std::size_t n_waiting_[N_PRIORITIES] = {0, 0};
     // factory for producing new decoders on demand
     std::unique_ptr<DecoderFactory> decoder_factory_;
 };
 
 
+// Early winner selection among decoders decoding the same audio with different
+// models (e.g. one per language, to identify the language). The decoders'
+// drivers report their progress; at checkpoints every `interval` secs of audio
+// (from `min_secs` on) the decoders are compared by their best path scores and
+// those trailing the leader by more than `margin` get cancelled, so that only
+// the likely winners are decoded to completion. Decoders progressing at
+// different speeds are compared at the same checkpoint without waiting for
+// each other.
+class DecoderRace final {
+
+  public:
+    // a non-positive interval checks once at `min_secs`
+    DecoderRace(const std::vector<Decoder*> &decoders,
+                const float &margin,
+                const float &min_secs,
+                const float &interval);
+
+    DecoderRace(const DecoderRace &) = delete; // disable copying
+
+    DecoderRace &operator=(const DecoderRace &) = delete; // disable assignment
+
+    // reports that the decoder has decoded `audio_secs` of the audio
+    // (called by its driver in between advancing it)
+    void report(Decoder *const decoder, const double &audio_secs);
+
+    // takes a decoder that stopped for another reason (its deadline, the
+    // client or a failure) out of the race, checkpoints stop waiting on it
+    void withdraw(Decoder *const decoder);
+
+    // tells if the decoder got cancelled for trailing the leader
+    bool eliminated(Decoder *const decoder);
+
+    // the decoder's score at the last checkpoint it reached (-inf if none)
+    kaldi::BaseFloat score(Decoder *const decoder);
+
+  private:
+    struct Entry {
+        Decoder *decoder;
+        bool eliminated;
+        bool withdrawn;
+        // score at every checkpoint reached
+        std::vector<kaldi::BaseFloat> scores;
+    };
+
+    Entry &entry_(Decoder *const decoder);
+
+    // compares the decoders at every checkpoint all the racers have reached
+    void advance_();
+
+    // compares the decoders still in the race at the checkpoint
+    void check_(const std::size_t &checkpoint);
+
+    std::vector<Entry> entries_;
+    const float margin_;
+    const float min_secs_;
+    const float interval_;
+    // no. of checkpoints compared so far
+    std::size_t n_checked_;
+    std::mutex mutex_;
+};
+
+
 void find_alternatives(kaldi::CompactLattice &clat,
                        const std::size_t &n_best,
                        utterance_results_t &results,
@@ -242,4 +542,53 @@ static void read_raw_wav_stream(std::istream &wav_stream,
     }
 }
 
+
+// Reads raw headerless 16-bit pcm data into caller owned buffers. Samples are
+// laid out channel after channel, i.e. channel `c` starts at
+// `c * (samples.size() / num_channels)`. The buffers keep their capacity
+// across calls so that reading every chunk of a stream does not reallocate.
+// Bytes of an incomplete trailing sample block are left in `buffer` and
+// prefixed to the data read by the next call (clear it to start afresh).
+static void read_raw_wav_stream(std::istream &wav_stream,
+                                const size_t &data_bytes,
+                                std::vector<char> &buffer,
+                                std::vector<kaldi::BaseFloat> &samples,
+                                const size_t &num_channels = 1,
+                                const size_t &sample_width = 2) {
+    const size_t block_align = num_channels * sample_width;
+
+    const size_t pending_bytes = buffer.size();
+    buffer.resize(pending_bytes + data_bytes);
+    wav_stream.read(buffer.data() + pending_bytes, data_bytes);
+    const size_t bytes_read = wav_stream.gcount();
+
+    if (wav_stream.bad())
+        KALDI_ERR << "WaveData: file read error";
+
+    if (bytes_read == 0)
+        KALDI_ERR << "WaveData: empty file (no data)";
+
+    if (bytes_read < data_bytes) {
+        KALDI_WARN << "Expected " << data_bytes << " bytes of wave data, "
+                   << "but read only " << bytes_read << " bytes. "
+                   << "Truncated file?";
+    }
+
+    const size_t total_bytes = pending_bytes + bytes_read;
+    const size_t num_samples = total_bytes / block_align;
+    const int16 *data_ptr = reinterpret_cast<const int16 *>(buffer.data());
+
+    samples.resize(num_channels * num_samples);
+    for (size_t i = 0; i < num_samples; ++i) {
+        for (size_t j = 0; j < num_channels; ++j) {
+            samples[j * num_samples + i] = *data_ptr++;
+        }
+    }
+
+    // keep the incomplete trailing block for the next call
+    const size_t consumed_bytes = num_samples * block_align;
+    std::copy(buffer.begin() + consumed_bytes, buffer.begin() + total_bytes, buffer.begin());
+    buffer.resize(total_bytes - consumed_bytes);
+}
+
 } // namespace kaldiserve
\ No newline at end of file
@@ -0,0 +1,141 @@
+// feature.hpp - Shared Feature Frontend Interface
+#pragma once
+
+// stl includes
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// kaldi includes
+#include "base/kaldi-common.h"
+#include "itf/online-feature-itf.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+
+// local includes
+#include "config.hpp"
+#include "types.hpp"
+
+
+namespace kaldiserve {
+
+class Decoder;
+class DecoderRace;
+class WorkerPool;
+
+// Online features behind a mutex, for decoders reading the same features from
+// several threads (the underlying features compute and cache frames lazily).
+class LockedFeature final : public kaldi::OnlineFeatureInterface {
+
+  public:
+    LockedFeature(kaldi::OnlineFeatureInterface *const feature, std::mutex &mutex) noexcept
+        : feature_(feature), mutex_(mutex) {}
+
+    kaldi::int32 Dim() const override;
+
+    kaldi::int32 NumFramesReady() const override;
+
+    bool IsLastFrame(kaldi::int32 frame) const override;
+
+    kaldi::BaseFloat FrameShiftInSeconds() const override;
+
+    void GetFrame(kaldi::int32 frame, kaldi::VectorBase<kaldi::BaseFloat> *feat) override;
+
+    void GetFrames(const std::vector<kaldi::int32> &frames, kaldi::MatrixBase<kaldi::BaseFloat> *feats) override;
+
+  private:
+    kaldi::OnlineFeatureInterface *const feature_;
+    std::mutex &mutex_;
+};
+
+// Feature extraction (features and i-vectors) of an utterance done once for
+// several decoders, e.g. of models decoding the same audio for language
+// identification or A/B tests. The decoders' models have to share their
+// feature config, which the model specs state with a common `feature_group`.
+// The decoders search in parallel while the audio is fed chunk by chunk.
+class SharedFrontend final {
+
+  public:
+    // starts decoding an utterance on each of the decoders off the frontend.
+    // the frontend is set up with the first decoder's feature config.
+    SharedFrontend(const std::vector<Decoder*> &decoders, const std::string &uuid = "");
+
+    SharedFrontend(const SharedFrontend &) = delete; // disable copying
+
+    SharedFrontend &operator=(const SharedFrontend &) = delete; // disable assignment
+
+    // frees the decoders (they can't outlive the features they read)
+    ~SharedFrontend();
+
+    // feeds an intermediate chunk of audio and advances all the decoders
+    // over the new frames (in parallel, on the worker pool if given)
+    void decode_chunk(const kaldi::VectorBase<kaldi::BaseFloat> &wave_part,
+                      const kaldi::BaseFloat &samp_freq,
+                      WorkerPool *const worker_pool = nullptr);
+
+    // feeds (independent) audio in chunks (secs, a non-positive value feeds it at once)
+    void decode_audio(const kaldi::VectorBase<kaldi::BaseFloat> &audio,
+                      const kaldi::BaseFloat &samp_freq,
+                      const float &chunk_size = 1,
+                      WorkerPool *const worker_pool = nullptr);
+
+    // feeds a wav file's (first channel) audio in chunks
+    void decode_wav_audio(std::istream &wav_stream,
+                          const float &chunk_size = 1,
+                          WorkerPool *const worker_pool = nullptr);
+
+    // feeds raw headerless 16-bit (mono) pcm audio in chunks
+    void decode_raw_wav_audio(std::istream &wav_stream,
+                              const float &samp_freq,
+                              const int &data_bytes,
+                              const float &chunk_size = 1,
+                              WorkerPool *const worker_pool = nullptr);
+
+    // marks the end of the audio, the decoders' final results may be taken after
+    void input_finished();
+
+    // reports the decoders' progress to a race after every chunk (the race
+    // has to outlive the decoding)
+    inline void set_race(DecoderRace *const race) noexcept {
+        race_ = race;
+    }
+
+    // marks the end of the audio and gets every decoder's final results (in
+    // the order of the decoders), finishing the searches in parallel.
+    // interrupted decoders (e.g. eliminated from a race) get no results.
+    void get_decoded_results(const int &n_best,
+                             std::vector<utterance_results_t> &results,
+                             const bool &word_level = false,
+                             WorkerPool *const worker_pool = nullptr);
+
+    // tells if every decoder got interrupted (no point in feeding more audio)
+    bool cancelled() noexcept;
+
+    inline kaldi::OnlineFeatureInterface *input_feature() noexcept {
+        return input_feature_.get();
+    }
+
+    // null for models without i-vectors
+    inline kaldi::OnlineFeatureInterface *ivector_feature() noexcept {
+        return ivector_feature_.get();
+    }
+
+  private:
+    // runs `task` for every decoder in parallel and waits for all of them
+    void for_each_decoder_(const std::function<void(Decoder *const)> &task, WorkerPool *const worker_pool);
+
+    std::vector<Decoder*> decoders_;
+    DecoderRace *race_;
+    // secs of audio fed so far
+    double audio_secs_;
+
+    std::mutex mutex_;
+    std::unique_ptr<kaldi::OnlineIvectorExtractorAdaptationState> adaptation_state_;
+    std::unique_ptr<kaldi::OnlineNnet2FeaturePipeline> feature_pipeline_;
+    std::unique_ptr<LockedFeature> input_feature_;
+    std::unique_ptr<LockedFeature> ivector_feature_;
+};
+
+} // namespace kaldiserve
\ No newline at end of file
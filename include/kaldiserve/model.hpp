@@ -34,6 +34,9 @@ class ChainModel final {
     // Model Config
     ModelSpec model_spec;
 
+    // NUMA node this replica was loaded on (-1 if not placed)
+    int numa_node = -1;
+
     // HCLG.fst graph
     std::unique_ptr<fst::Fst<fst::StdArc>> decode_fst;
 
@@ -47,7 +50,9 @@ class ChainModel final {
 
     // Online Feature Pipeline options
     std::unique_ptr<kaldi::OnlineNnet2FeaturePipelineInfo> feature_info;
-    // 
+    // Sampling frequency (Hz) the features are computed at
+    kaldi::BaseFloat samp_freq = 0;
+    // Looped nnet computation (compiled once, shared by all decoders)
     std::unique_ptr<kaldi::nnet3::DecodableNnetSimpleLoopedInfo> decodable_info;
     
     kaldi::LatticeFasterDecoderConfig lattice_faster_decoder_config;
@@ -24,10 +24,47 @@ struct ModelSpec {
     int min_active = 200;
     int max_active = 7000;
     int frame_subsampling_factor = 3;
+    // input frames the looped nnet computes at a time
+    int frames_per_chunk = 20;
     float beam = 16.0;
     float lattice_beam = 6.0;
     float acoustic_scale = 1.0;
     float silence_weight = 1.0;
+
+    // feature config (detected from the model's `conf` directory when unset)
+    // feature type (mfcc, fbank or plp), read from `conf/<feature_type>.conf`
+    std::string feature_type = "mfcc";
+    // i-vectors as an nnet input, read from `conf/ivector_extractor.conf`
+    bool use_ivectors = true;
+    // pitch features appended to the features, read from `conf/pitch.conf`
+    bool add_pitch = false;
+    // models of the same (non-empty) group share their feature config, so one
+    // utterance's features can be computed once for all of them (see `SharedFrontend`)
+    std::string feature_group;
+
+    // non-streaming config
+    // default chunk size (secs) in which audio is decoded
+    float chunk_size = 1.0;
+    // pick the chunk size with the best throughput during warm-up
+    bool auto_chunk_size = false;
+    // audio (secs) between i-vector silence weighting updates
+    // (non-positive updates once per chunk)
+    float silence_weighting_period = 1.0;
+
+    // streaming config
+    // min new (output) frames before the search is advanced, rounded up to
+    // whole nnet chunks (0 advances on every new chunk)
+    int advance_frames = 0;
+    // keep the utterance's audio for decoder snapshots (see `Decoder::snapshot`)
+    bool enable_snapshots = false;
+
+    // scheduling config
+    // max (output) frames decoded between two scheduling points (0 decodes all ready frames)
+    int quantum_frames = 50;
+
+    // numa config
+    // replicate the model on every NUMA node and pin decoders to their replica
+    bool numa_replicate = false;
     
     // rnnlm config
     int max_ngram_order = 3;
@@ -36,6 +73,31 @@ struct ModelSpec {
     std::string eos_index = "2";
 };
 
+// Server Specification
+// contains server wide config (`[server]` table of the toml).
+struct ServerSpec {
+    // decode worker pool size (0 decodes on the request handler threads)
+    int n_workers = 0;
+    // pin decode workers to cpus (spread over NUMA nodes)
+    bool pin_workers = false;
+    // secs a dropped bidi stream is kept for resumption (0 disables it)
+    float session_ttl = 0;
+    // secs an unfinished manifest job is kept for resumption after its last run (0 keeps it)
+    float job_ttl = 3600;
+    // directory audio `uri`s are read from (unset refuses uris)
+    std::string audio_root;
+    // default response compression (none, gzip or deflate)
+    std::string compression;
+    // secs active requests get to finish on shutdown (SIGTERM)
+    float drain_timeout = 30;
+    // address (host:port) the server listens on
+    std::string address = "0.0.0.0:5016";
+    // load models on their first request instead of at startup
+    bool lazy_load = false;
+    // GiB the loaded models may take up before idle ones get evicted (0 for no limit)
+    float memory_budget = 0;
+};
+
 struct Word {
     float start_time, end_time, confidence;
     std::string word;
@@ -48,6 +110,31 @@ struct Alternative {
     double confidence;
     float am_score, lm_score;
     std::vector<Word> words;
+    // no. of leading words that won't change anymore (all of them for
+    // final results, the prefix shared by all active paths for partials
+    // when asked for)
+    int stable_words = 0;
+};
+
+// Priority class of decoding work, realtime (streaming) work is always
+// served before batch (offline) work.
+enum Priority {
+    REALTIME = 0,
+    BATCH = 1,
+    N_PRIORITIES = 2
+};
+
+// Load of a decoder queue at a point in time (for capacity reporting).
+struct QueueStatus {
+    std::size_t n_decoders = 0;
+    // decoders free to be acquired right away
+    std::size_t n_free = 0;
+    // threads waiting for a decoder
+    std::size_t n_waiting = 0;
+    // estimated secs a new request waits for a decoder
+    double wait_estimate = 0;
+    // recent real time factor (decoding secs per audio sec)
+    double rtf = 0;
 };
 
 // Options for decoder
@@ -2,6 +2,7 @@
 #pragma once
 
 // stl includes
+#include <stdexcept>
 #include <string>
 #include <vector>
 
@@ -19,10 +20,71 @@ std::string join_path(std::string a, std::string b);
 
 bool exists(std::string path);
 
-// Fills a list of model specifications from the config
+// Error in the config toml, listing every problem found (not just the first)
+class ConfigError : public std::runtime_error {
+  public:
+    ConfigError(const std::string &toml_path, const std::vector<std::string> &errors);
+
+    inline const std::vector<std::string> &errors() const noexcept {
+        return errors_;
+    }
+
+  private:
+    std::vector<std::string> errors_;
+};
+
+// Fills the model specifications (`[[model]]` tables) and the server specification
+// (optional `[server]` table) from the config. Throws a `ConfigError` on missing
+// required keys, unknown keys, values of the wrong type or range and missing
+// model artefacts (the model directories are checked concurrently).
+void parse_config(const std::string &toml_path, std::vector<ModelSpec> &model_specs, ServerSpec &server_spec);
+
+// Fills a list of model specifications from the config (see `parse_config`)
 void parse_model_specs(const std::string &toml_path, std::vector<ModelSpec> &model_specs);
 
+// Fills the server specification from the (optional) `[server]` table of the config
+void parse_server_spec(const std::string &toml_path, ServerSpec &server_spec);
+
+// Lists the artefacts missing from the model's directory
+std::vector<std::string> model_artefact_errors(const ModelSpec &model_spec);
+
 // Joins vector of strings together using a separator token
 void string_join(const std::vector<std::string> &strings, std::string separator, std::string &output);
 
+// Returns the number of NUMA nodes on this machine (1 if unknown)
+int numa_node_count();
+
+// Returns the NUMA node of the cpu the calling thread is running on
+int current_numa_node();
+
+// Returns the cpus of the given NUMA node (empty if unknown)
+std::vector<int> numa_node_cpus(const int &node);
+
+// Restricts the calling thread to the cpus of the given NUMA node
+bool pin_thread_to_numa_node(const int &node);
+
+// Restricts the calling thread to a single cpu
+bool pin_thread_to_cpu(const int &cpu);
+
+// Restricts the calling thread to the cpus of a NUMA node while in scope and
+// restores its previous cpu affinity afterwards (no-op on single node machines)
+class ScopedNumaPin final {
+
+  public:
+    explicit ScopedNumaPin(const int &node);
+
+    ScopedNumaPin(const ScopedNumaPin &) = delete; // disable copying
+
+    ScopedNumaPin &operator=(const ScopedNumaPin &) = delete; // disable assignment
+
+    ~ScopedNumaPin();
+
+  private:
+    // cpus the thread could run on before (empty if it wasn't pinned)
+    std::vector<int> previous_cpus_;
+};
+
+// Returns the resident memory (bytes) of this process (0 if unknown)
+std::size_t resident_memory();
+
 } // namespace kaldiserve
\ No newline at end of file
@@ -0,0 +1,94 @@
+// wav.hpp - WAV Stream Parser Interface
+#pragma once
+
+// stl includes
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// kaldi includes
+#include "base/kaldi-common.h"
+
+// local includes
+#include "config.hpp"
+
+
+namespace kaldiserve {
+
+// Sample encodings the parser understands
+enum SampleFormat {
+    PCM_16 = 0,     // 16-bit signed integer pcm
+    FLOAT_32 = 1    // 32-bit ieee float in [-1, 1]
+};
+
+// Stateful parser for WAV audio arriving in chunks. The RIFF header is parsed
+// once per stream (it may be split across chunks) and the chunks after it are
+// read as raw data in the stream's format, straight from the caller's memory.
+// Samples are scaled to the 16-bit range that kaldi features expect.
+// A chunk starting (at a sample block boundary) with a RIFF header that has its
+// fmt chunk restarts the stream, so clients that send a header with every chunk
+// keep working.
+class WavStreamParser final {
+
+  public:
+    WavStreamParser() noexcept;
+
+    // forgets the stream format and any buffered bytes
+    void reset() noexcept;
+
+    // parses the next `size` bytes of the stream into the samples of the given
+    // channel (replacing the contents of `samples`). bytes of a sample block
+    // split across chunks are carried over to the next call.
+    void parse(const char *data, std::size_t size,
+               std::vector<kaldi::BaseFloat> &samples,
+               const std::size_t &channel = 0);
+
+    // tells whether the stream header has been parsed
+    inline bool has_header() const noexcept {
+        return has_header_;
+    }
+
+    inline kaldi::BaseFloat samp_freq() const noexcept {
+        return samp_freq_;
+    }
+
+    inline std::size_t num_channels() const noexcept {
+        return num_channels_;
+    }
+
+    inline SampleFormat sample_format() const noexcept {
+        return sample_format_;
+    }
+
+    // writes/reads the stream format and buffered bytes (kaldi binary io)
+    void write(std::ostream &os) const;
+    void read(std::istream &is);
+
+  private:
+    // parses the RIFF header at the start of `data`, setting `header_size` to
+    // the offset of the audio data. returns false if the header is incomplete.
+    bool parse_header_(const char *data, const std::size_t &size, std::size_t &header_size);
+
+    // appends the channel's samples of the complete blocks in `data`
+    void read_samples_(const char *data, std::size_t size,
+                       std::vector<kaldi::BaseFloat> &samples,
+                       const std::size_t &channel);
+
+    // decodes a single sample
+    kaldi::BaseFloat sample_(const char *data) const noexcept;
+
+    // stream format
+    bool has_header_;
+    kaldi::BaseFloat samp_freq_;
+    std::size_t num_channels_;
+    std::size_t sample_width_;
+    std::size_t block_align_;
+    SampleFormat sample_format_;
+
+    // a header is being read (and buffered in `pending_`)
+    bool in_header_;
+    // bytes of an incomplete header or sample block
+    std::vector<char> pending_;
+};
+
+} // namespace kaldiserve
\ No newline at end of file
@@ -0,0 +1,94 @@
+// worker.hpp - Decode Worker Pool Interface
+#pragma once
+
+// stl includes
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// local includes
+#include "config.hpp"
+#include "types.hpp"
+
+
+namespace kaldiserve {
+
+// Fixed size pool of worker threads that runs the decoding work submitted by
+// request handler threads, so that the CPU spent on decoding is bounded by the
+// pool size instead of the number of concurrent requests. A pool without
+// workers runs every task on the submitting thread.
+// Pinned workers are spread over the NUMA nodes (and the cpus within them);
+// each node gets its own task lane which its workers look into first.
+// Realtime tasks are always picked before batch tasks, and batch tasks hand
+// over their worker to waiting realtime tasks at every `yield` point.
+class WorkerPool final {
+
+  public:
+    explicit WorkerPool(const std::size_t &n_workers, const bool &pin_workers = false);
+
+    WorkerPool(const WorkerPool &) = delete; // disable copying
+
+    WorkerPool &operator=(const WorkerPool &) = delete; // disable assignment
+
+    // finishes the pending tasks and joins the workers
+    ~WorkerPool();
+
+    // queues a task, preferably for the workers on the given NUMA node.
+    // the returned future rethrows any exception raised by the task.
+    std::future<void> submit(std::function<void()> task,
+                             const int &numa_node = -1,
+                             const Priority &priority = REALTIME);
+
+    // submits a task and waits for it to finish
+    inline void run(std::function<void()> task,
+                    const int &numa_node = -1,
+                    const Priority &priority = REALTIME) {
+        submit(std::move(task), numa_node, priority).get();
+    }
+
+    inline std::size_t size() const noexcept {
+        return workers_.size();
+    }
+
+    // Scheduling point for long running tasks: when called from a batch task
+    // running on a pool worker, runs the pending realtime tasks in place
+    // before returning. No-op on any other thread.
+    static void yield();
+
+  private:
+    // worker thread loop
+    void work_(const std::size_t &lane);
+
+    // waits for the next task, looking into the given lane first.
+    // returns false once the pool is stopped and drained.
+    bool pop_(const std::size_t &lane, std::packaged_task<void()> &task, Priority &priority);
+
+    // pops the next task with at most the given priority level without waiting
+    // (expects the mutex to be held)
+    bool try_pop_(const std::size_t &lane, const Priority &lowest,
+                  std::packaged_task<void()> &task, Priority &priority);
+
+    // runs a task recording its priority for nested `yield` calls
+    void run_task_(std::packaged_task<void()> &task, const Priority &priority);
+
+    // pending tasks queue for a priority class and lane
+    inline std::queue<std::packaged_task<void()>> &queue_(const Priority &priority, const std::size_t &lane) {
+        return queues_[priority * n_lanes_ + lane];
+    }
+
+    std::vector<std::thread> workers_;
+    // no. of task lanes (one per NUMA node when pinned)
+    std::size_t n_lanes_;
+    // pending tasks (per priority class, per lane)
+    std::vector<std::queue<std::packaged_task<void()>>> queues_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopped_ = false;
+};
+
+} // namespace kaldiserve
\ No newline at end of file
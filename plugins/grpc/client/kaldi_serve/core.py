@@ -1,6 +1,6 @@
 import grpc
 
-from kaldi_serve.kaldi_serve_pb2 import RecognitionConfig, RecognizeRequest
+from kaldi_serve.kaldi_serve_pb2 import ManifestRecognizeRequest, RecognitionConfig, RecognizeRequest
 from kaldi_serve.kaldi_serve_pb2_grpc import KaldiServeStub
 
 
@@ -33,4 +33,8 @@ class KaldiServeClient(object):
 
     def bidi_streaming_recognize_raw(self, audio_params_gen, uuid: str, timeout=None):
         request_gen = (RecognizeRequest(config=config, audio=chunk, uuid=uuid) for config, chunk in audio_params_gen)
-        return self._client.BidiStreamingRecognize(request_gen, timeout=timeout)
\ No newline at end of file
+        return self._client.BidiStreamingRecognize(request_gen, timeout=timeout)
+
+    def recognize_manifest(self, config: RecognitionConfig, manifest, job_id: str = "", max_in_flight: int = 0, timeout=None):
+        request = ManifestRecognizeRequest(config=config, manifest=manifest, job_id=job_id, max_in_flight=max_in_flight)
+        return self._client.RecognizeManifest(request, timeout=timeout)
\ No newline at end of file
@@ -0,0 +1,49 @@
+# Manifest jobs against a running server. The server needs the `general` (hi)
+# model with `n_decoders` below the window asked for here, and `audio_root`
+# pointing at ./tests/resources so that the manifest's uris resolve.
+import threading
+
+from kaldi_serve import KaldiServeClient, RecognitionAudio, RecognitionConfig
+
+MANIFEST = "\n".join([
+    "hi/one_two_three_four.wav",
+    "hi/five_six_seven_eight.wav",
+    "hi/nine_ten_eleven_twelve.wav",
+] * 4)
+
+MAX_IN_FLIGHT = 8
+
+
+def test_concurrent_manifests():
+    """
+    Two jobs sharing a model, each with a window wider than the model's decoder
+    queue, have to both run through (and not wait on each other's decoders).
+    """
+    client = KaldiServeClient()
+    config = RecognitionConfig(
+        sample_rate_hertz=8000,
+        encoding=RecognitionConfig.AudioEncoding.LINEAR16,
+        language_code="hi",
+        max_alternatives=1,
+        model="general"
+    )
+    manifest = RecognitionAudio(content=MANIFEST.encode("utf-8"))
+
+    n_items = len(MANIFEST.splitlines())
+    results = [None, None]
+
+    def run_job(index: int):
+        responses = client.recognize_manifest(config, manifest, max_in_flight=MAX_IN_FLIGHT, timeout=120)
+        results[index] = [response for response in responses]
+
+    threads = [threading.Thread(target=run_job, args=(i, )) for i in range(2)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join(timeout=150)
+        assert not thread.is_alive()
+
+    for responses in results:
+        assert responses is not None
+        assert sorted(response.index for response in responses) == list(range(n_items))
+        assert all(response.error == "" for response in responses)
\ No newline at end of file
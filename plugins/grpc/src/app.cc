@@ -36,19 +36,48 @@ int main(int argc, char *argv[]) {
     CLI11_PARSE(app, argc, argv);
 
     std::vector<ModelSpec> model_specs;
-    parse_model_specs(model_spec_toml, model_specs);
+    ServerSpec server_spec;
+    try {
+        parse_config(model_spec_toml, model_specs, server_spec);
+    } catch (const ConfigError &e) {
+        std::cout << ":: Invalid config " << model_spec_toml << ENDL;
+        for (auto const &error : e.errors()) {
+            std::cout << "::   - " << error << ENDL;
+        }
+        return 1;
+    }
 
     if (model_specs.size() == 0) {
         std::cout << ":: No model found in toml for loading" << ENDL;
         return 1;
     }
 
-    std::cout << ":: Loading " << model_specs.size() << " models" << ENDL;
+    std::cout << ":: " << (server_spec.lazy_load ? "Declared " : "Loading ") << model_specs.size() << " models" << ENDL;
     for (auto const &model_spec : model_specs) {
         std::cout << "::   - " << model_spec.name + " (" + model_spec.language_code + ")" << ENDL;
     }
 
-    run_server(model_specs);
+    if (server_spec.n_workers > 0) {
+        std::cout << ":: Decoding on " << server_spec.n_workers << " worker threads" << ENDL;
+    }
+
+    if (server_spec.lazy_load) {
+        std::cout << ":: Loading models on their first request" << ENDL;
+    }
+
+    if (server_spec.memory_budget > 0) {
+        std::cout << ":: Evicting idle models beyond " << server_spec.memory_budget << "GiB" << ENDL;
+    }
+
+    if (server_spec.session_ttl > 0) {
+        std::cout << ":: Keeping dropped streams for " << server_spec.session_ttl << "s" << ENDL;
+    }
+
+    if (server_spec.job_ttl > 0) {
+        std::cout << ":: Keeping unfinished manifest jobs for " << server_spec.job_ttl << "s" << ENDL;
+    }
+
+    run_server(model_specs, server_spec);
 
     return 0;
 }
@@ -0,0 +1,138 @@
+// job.hpp - Manifest Job Store
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// gRPC inludes
+#include <grpcpp/support/status.h>
+
+// local includes
+#include "config.hpp"
+
+
+// Progress of a manifest job: which of its items have been delivered.
+struct ManifestJob {
+    std::vector<bool> done;
+    std::size_t n_done = 0;
+    // a job is run by a single stream at a time
+    bool running = false;
+    // when a job that isn't running gets forgotten
+    std::chrono::steady_clock::time_point expiry;
+};
+
+
+// JobStore ::
+// Keeps the progress of manifest jobs (in memory) by job id, so that a client
+// whose stream broke off resumes the job with only the undelivered items.
+// Jobs are forgotten once all their items are delivered, or when they are
+// not resumed within a time to live of their last run (abandoned jobs).
+class JobStore final {
+
+  public:
+    // a non-positive time to live keeps unfinished jobs for good
+    explicit JobStore(const std::chrono::milliseconds &ttl);
+
+    JobStore(const JobStore &) = delete; // disable copying
+
+    JobStore &operator=(const JobStore &) = delete; // disable assignment
+
+    ~JobStore();
+
+    // claims the job for running, a new one (with a fresh id) if `job_id` is empty
+    grpc::Status claim(std::string &job_id, const std::size_t &n_items, std::shared_ptr<ManifestJob> &job);
+
+    // hands the job back after a run
+    void unclaim(const std::string &job_id, const std::shared_ptr<ManifestJob> &job);
+
+  private:
+    // reaper thread loop, forgets the expired jobs
+    void reap_();
+
+    const std::chrono::milliseconds ttl_;
+
+    std::unordered_map<std::string, std::shared_ptr<ManifestJob>> jobs_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::atomic<std::size_t> n_jobs_;
+    bool stop_;
+    std::thread reaper_;
+};
+
+JobStore::JobStore(const std::chrono::milliseconds &ttl) : ttl_(ttl), n_jobs_(0), stop_(false) {
+    if (ttl_.count() > 0) reaper_ = std::thread(&JobStore::reap_, this);
+}
+
+JobStore::~JobStore() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    lock.unlock();
+    cond_.notify_all();
+
+    if (reaper_.joinable()) reaper_.join();
+}
+
+grpc::Status JobStore::claim(std::string &job_id, const std::size_t &n_items, std::shared_ptr<ManifestJob> &job) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (job_id.empty()) {
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        job_id = "job-" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()) +
+                 "-" + std::to_string(n_jobs_++);
+    }
+
+    auto it = jobs_.find(job_id);
+    if (it == jobs_.end()) {
+        job = std::make_shared<ManifestJob>();
+        job->done.resize(n_items, false);
+        jobs_[job_id] = job;
+    } else {
+        job = it->second;
+        if (job->running) {
+            return grpc::Status(grpc::StatusCode::ABORTED, "Job " + job_id + " is already running");
+        }
+        if (job->done.size() != n_items) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Job " + job_id + " was started with a different manifest");
+        }
+    }
+    job->running = true;
+    return grpc::Status::OK;
+}
+
+void JobStore::unclaim(const std::string &job_id, const std::shared_ptr<ManifestJob> &job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    job->running = false;
+    job->expiry = std::chrono::steady_clock::now() + ttl_;
+    if (job->n_done == job->done.size()) jobs_.erase(job_id);
+    lock.unlock();
+    cond_.notify_all();
+}
+
+void JobStore::reap_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        auto now = std::chrono::steady_clock::now();
+        auto next_expiry = now + ttl_;
+
+        for (auto it = jobs_.begin(); it != jobs_.end();) {
+            const ManifestJob &job = *it->second;
+            if (!job.running && job.expiry <= now) {
+                if (DEBUG) std::cout << "[" << timestamp_now() << "] job: " << it->first << " expired" << ENDL;
+                it = jobs_.erase(it);
+            } else {
+                if (!job.running) next_expiry = std::min(next_expiry, job.expiry);
+                it++;
+            }
+        }
+        cond_.wait_until(lock, next_expiry);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,220 @@
+// model_store.hpp - Model Store (lazy loading)
+#pragma once
+
+// stl includes
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// lib includes
+#include <kaldiserve/decoder.hpp>
+#include <kaldiserve/utils.hpp>
+
+// gRPC inludes
+#include <grpcpp/support/status.h>
+
+// local includes
+#include "config.hpp"
+#include "kaldi_serve.grpc.pb.h"
+
+using namespace kaldiserve;
+
+
+// ModelStore ::
+// Owns the decoder queues of the models declared in the config. With lazy
+// loading a model is only loaded on its first request (other requests for it
+// wait meanwhile). Under a memory budget, the least recently used models that
+// are not in use get evicted to make room, to be loaded again when asked for.
+class ModelStore final {
+
+  public:
+    // a zero memory budget (bytes) never evicts
+    ModelStore(const std::vector<ModelSpec> &model_specs, const bool &lazy_load, const std::size_t &memory_budget);
+
+    ModelStore(const ModelStore &) = delete; // disable copying
+
+    ModelStore &operator=(const ModelStore &) = delete; // disable assignment
+
+    // tells if the model is declared (loaded or not)
+    inline bool has(const model_id_t &model_id) const noexcept {
+        return models_.find(model_id) != models_.end();
+    }
+
+    // gets the decoder queue of the model, loading it first if needed. the
+    // model is not evicted while the queue is held.
+    grpc::Status get(const model_id_t &model_id, std::shared_ptr<DecoderQueue> &decoder_queue);
+
+    // adds the status of every declared model to the response
+    void status(kaldi_serve::StatusResponse *const response);
+
+  private:
+    struct Model {
+        ModelSpec spec;
+        std::shared_ptr<DecoderQueue> decoder_queue;
+        bool loading = false;
+        std::chrono::steady_clock::time_point last_used;
+        // resident memory the model took up when last loaded (bytes)
+        std::size_t memory = 0;
+        // load and eviction metrics
+        std::size_t n_loads = 0;
+        std::size_t n_evictions = 0;
+        double load_secs = 0;
+    };
+
+    // evicts least recently used idle models (other than `model_id`) until
+    // `needed` more bytes fit in the budget. evicted queues are moved out to
+    // be destroyed after unlocking.
+    void make_room_(const std::size_t &needed, const model_id_t &model_id,
+                    std::vector<std::shared_ptr<DecoderQueue>> &evicted);
+
+    std::unordered_map<model_id_t, Model, model_id_hash> models_;
+    const std::size_t memory_budget_;
+    // memory taken up by the loaded models (bytes)
+    std::size_t memory_used_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    // models are loaded one at a time so that their memory can be measured
+    std::mutex load_mutex_;
+};
+
+ModelStore::ModelStore(const std::vector<ModelSpec> &model_specs, const bool &lazy_load, const std::size_t &memory_budget)
+    : memory_budget_(memory_budget), memory_used_(0) {
+    for (auto const &model_spec : model_specs) {
+        model_id_t model_id = std::make_pair(model_spec.name, model_spec.language_code);
+        models_[model_id].spec = model_spec;
+    }
+
+    if (lazy_load) return;
+
+    for (auto const &entry : models_) {
+        std::shared_ptr<DecoderQueue> decoder_queue;
+        grpc::Status status = get(entry.first, decoder_queue);
+        if (!status.ok()) KALDI_ERR << status.error_message();
+    }
+}
+
+grpc::Status ModelStore::get(const model_id_t &model_id, std::shared_ptr<DecoderQueue> &decoder_queue) {
+    auto it = models_.find(model_id);
+    if (it == models_.end()) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND, "Model " + model_id.first + " (" + model_id.second + ") not found");
+    }
+    Model &model = it->second;
+
+    std::vector<std::shared_ptr<DecoderQueue>> evicted;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (model.loading) cond_.wait(lock);
+
+    if (!model.decoder_queue) {
+        model.loading = true;
+        // a model loaded before is expected to take up as much memory again
+        make_room_(model.memory, model_id, evicted);
+        lock.unlock();
+
+        evicted.clear();
+
+        std::shared_ptr<DecoderQueue> loaded_queue;
+        std::string error;
+        std::size_t memory = 0;
+        std::chrono::duration<double> load_time(0);
+        {
+            std::lock_guard<std::mutex> load_lock(load_mutex_);
+            const std::size_t memory_before = resident_memory();
+            const auto start = std::chrono::steady_clock::now();
+            try {
+                loaded_queue = std::make_shared<DecoderQueue>(model.spec);
+            } catch (std::exception &e) {
+                error = e.what();
+            }
+            load_time = std::chrono::steady_clock::now() - start;
+            const std::size_t memory_after = resident_memory();
+            memory = memory_after > memory_before ? memory_after - memory_before : 0;
+        }
+
+        lock.lock();
+        model.loading = false;
+        cond_.notify_all();
+
+        if (!loaded_queue) {
+            return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Failed to load model " + model_id.first + " (" + model_id.second + "): " + error);
+        }
+
+        model.decoder_queue = loaded_queue;
+        model.memory = memory;
+        model.n_loads++;
+        model.load_secs = load_time.count();
+        memory_used_ += memory;
+
+        std::cout << ":: Loaded model " << model_id.first << " (" << model_id.second << ") in "
+                  << model.load_secs << "s, taking up " << memory / (1 << 20) << "MiB" << ENDL;
+
+        make_room_(0, model_id, evicted);
+    }
+
+    model.last_used = std::chrono::steady_clock::now();
+    decoder_queue = model.decoder_queue;
+    lock.unlock();
+
+    return grpc::Status::OK;
+}
+
+void ModelStore::make_room_(const std::size_t &needed, const model_id_t &model_id,
+                            std::vector<std::shared_ptr<DecoderQueue>> &evicted) {
+    if (memory_budget_ == 0) return;
+
+    while (memory_used_ + needed > memory_budget_) {
+        // models held by requests (or parked sessions) stay
+        Model *lru_model = nullptr;
+        const model_id_t *lru_model_id = nullptr;
+        for (auto &entry : models_) {
+            Model &model = entry.second;
+            if (entry.first == model_id || !model.decoder_queue || model.decoder_queue.use_count() > 1) continue;
+
+            if (lru_model == nullptr || model.last_used < lru_model->last_used) {
+                lru_model = &model;
+                lru_model_id = &entry.first;
+            }
+        }
+        if (lru_model == nullptr) return;
+
+        evicted.push_back(std::move(lru_model->decoder_queue));
+        lru_model->decoder_queue = nullptr;
+        lru_model->n_evictions++;
+        memory_used_ -= std::min(memory_used_, lru_model->memory);
+
+        std::cout << ":: Evicted model " << lru_model_id->first << " (" << lru_model_id->second << ")" << ENDL;
+    }
+}
+
+void ModelStore::status(kaldi_serve::StatusResponse *const response) {
+    std::unique_lock<std::mutex> lock(mutex_);
+
+    for (auto const &entry : models_) {
+        const Model &model = entry.second;
+
+        kaldi_serve::ModelStatus *model_status = response->add_models();
+        model_status->set_model(entry.first.first);
+        model_status->set_language_code(entry.first.second);
+        model_status->set_loaded(model.decoder_queue != nullptr);
+        model_status->set_memory(model.decoder_queue ? model.memory : 0);
+        model_status->set_loads(model.n_loads);
+        model_status->set_evictions(model.n_evictions);
+        model_status->set_load_time(model.load_secs);
+
+        if (!model.decoder_queue) continue;
+
+        const QueueStatus status = model.decoder_queue->status();
+        model_status->set_n_decoders(status.n_decoders);
+        model_status->set_free_decoders(status.n_free);
+        model_status->set_busy_decoders(status.n_decoders - status.n_free);
+        model_status->set_waiting_requests(status.n_waiting);
+        model_status->set_wait_estimate(status.wait_estimate);
+        model_status->set_rtf(status.rtf);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+// router.cc - gRPC Router Entry
+
+// stl includes
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// local includes
+#include "config.hpp"
+#include "router.hpp"
+
+// vendor includes
+#include "vendor/CLI11.hpp"
+
+using namespace kaldiserve;
+
+
+int main(int argc, char *argv[]) {
+    CLI::App app{"Kaldi gRPC router"};
+
+    std::vector<std::string> replica_addresses;
+    app.add_option("replicas", replica_addresses, "Addresses (host:port) of the kaldi-serve replicas to route to")
+      ->required();
+
+    std::string address = "0.0.0.0:5015";
+    app.add_option("-a,--address", address, "Address to listen on", true);
+
+    float poll_interval = 1.0;
+    app.add_option("-p,--poll-interval", poll_interval, "Secs between polls of the replicas' status", true)
+      ->check(CLI::PositiveNumber);
+
+    app.add_flag("-d,--debug", DEBUG, "Flag to enable debug mode");
+
+    app.add_flag_callback("-v,--version", print_version, "Show program version and exit");
+
+    CLI11_PARSE(app, argc, argv);
+
+    std::cout << ":: Routing to " << replica_addresses.size() << " replicas" << ENDL;
+    for (auto const &replica_address : replica_addresses) {
+        std::cout << "::   - " << replica_address << ENDL;
+    }
+
+    run_router(address, replica_addresses, std::chrono::milliseconds(static_cast<int64_t>(poll_interval * 1000)));
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,438 @@
+// router.hpp - gRPC Model Router
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// lib includes
+#include <kaldiserve/types.hpp>
+
+// gRPC inludes
+#include <grpc/grpc.h>
+#include <grpcpp/client_context.h>
+#include <grpcpp/create_channel.h>
+#include <grpcpp/security/credentials.h>
+#include <grpcpp/security/server_credentials.h>
+#include <grpcpp/server.h>
+#include <grpcpp/server_builder.h>
+#include <grpcpp/server_context.h>
+
+// local includes
+#include "config.hpp"
+#include "kaldi_serve.grpc.pb.h"
+
+
+// A kaldi-serve server the router forwards requests to, along with the
+// models (and their load) it reported on the last poll.
+struct Replica {
+    std::string address;
+    std::unique_ptr<kaldi_serve::KaldiServe::Stub> stub;
+
+    bool serving = false;
+    std::unordered_map<model_id_t, kaldi_serve::ModelStatus, model_id_hash> models;
+    int64_t resident_memory = 0;
+    int32_t active_requests = 0;
+    // requests routed to the replica since its last poll (not in its status yet)
+    std::size_t n_routed = 0;
+};
+
+
+// ReplicaSet ::
+// Keeps track of which replicas host which models by polling their `GetStatus`
+// periodically, so that models loaded (or unloaded) on a replica are picked up
+// without restarting the router. Requests for a model go to the least loaded
+// replica hosting it.
+class ReplicaSet final {
+
+  public:
+    ReplicaSet(const std::vector<std::string> &addresses, const std::chrono::milliseconds &poll_interval);
+
+    ReplicaSet(const ReplicaSet &) = delete; // disable copying
+
+    ReplicaSet &operator=(const ReplicaSet &) = delete; // disable assignment
+
+    ~ReplicaSet();
+
+    // picks the replica to serve a request for the model (nullptr if none hosts it)
+    Replica *pick(const model_id_t &model_id);
+
+    // fills the combined status of all the replicas (per model)
+    void status(kaldi_serve::StatusResponse *const response);
+
+  private:
+    // poller thread loop, refreshes the replicas' status
+    void poll_();
+
+    // expected share of a replica's decoders in use once a request is routed to it
+    static double load_(const Replica &replica, const kaldi_serve::ModelStatus &model_status) noexcept;
+
+    const std::chrono::milliseconds poll_interval_;
+
+    std::vector<std::unique_ptr<Replica>> replicas_;
+    // replica to start the search for the least loaded one from (rotated for ties)
+    std::size_t next_replica_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_;
+    std::thread poller_;
+};
+
+ReplicaSet::ReplicaSet(const std::vector<std::string> &addresses, const std::chrono::milliseconds &poll_interval)
+    : poll_interval_(poll_interval), next_replica_(0), stop_(false) {
+    for (auto const &address : addresses) {
+        std::unique_ptr<Replica> replica(new Replica());
+        replica->address = address;
+        replica->stub = kaldi_serve::KaldiServe::NewStub(grpc::CreateChannel(address, grpc::InsecureChannelCredentials()));
+        replicas_.push_back(std::move(replica));
+    }
+    poller_ = std::thread(&ReplicaSet::poll_, this);
+}
+
+ReplicaSet::~ReplicaSet() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    lock.unlock();
+    cond_.notify_all();
+
+    if (poller_.joinable()) poller_.join();
+}
+
+double ReplicaSet::load_(const Replica &replica, const kaldi_serve::ModelStatus &model_status) noexcept {
+    // a replica yet to load the model is only picked over ones whose decoders are all taken
+    if (!model_status.loaded()) return 1.0 + replica.n_routed;
+
+    const double n_decoders = std::max(model_status.n_decoders(), 1);
+    return (model_status.busy_decoders() + model_status.waiting_requests() + replica.n_routed + 1) / n_decoders;
+}
+
+Replica *ReplicaSet::pick(const model_id_t &model_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    Replica *best_replica = nullptr;
+    double best_load = 0;
+
+    for (std::size_t i = 0; i < replicas_.size(); i++) {
+        Replica *replica = replicas_[(next_replica_ + i) % replicas_.size()].get();
+        if (!replica->serving) continue;
+
+        auto it = replica->models.find(model_id);
+        if (it == replica->models.end()) continue;
+
+        const double load = load_(*replica, it->second);
+        if (best_replica == nullptr || load < best_load) {
+            best_replica = replica;
+            best_load = load;
+        }
+    }
+
+    if (best_replica != nullptr) best_replica->n_routed++;
+    next_replica_++;
+    return best_replica;
+}
+
+void ReplicaSet::status(kaldi_serve::StatusResponse *const response) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::unordered_map<model_id_t, kaldi_serve::ModelStatus, model_id_hash> models;
+    int64_t resident_memory = 0;
+    int32_t active_requests = 0;
+    bool serving = false;
+
+    for (auto const &replica : replicas_) {
+        if (!replica->serving) continue;
+        serving = true;
+        resident_memory += replica->resident_memory;
+        active_requests += replica->active_requests;
+
+        for (auto const &entry : replica->models) {
+            const kaldi_serve::ModelStatus &model_status = entry.second;
+
+            auto it = models.find(entry.first);
+            if (it == models.end()) {
+                models[entry.first] = model_status;
+                continue;
+            }
+
+            // decoders add up, a new request waits as long as on the best replica
+            // and the rtf is averaged over the decoders
+            kaldi_serve::ModelStatus &total = it->second;
+            const int32_t n_decoders = total.n_decoders() + model_status.n_decoders();
+            if (n_decoders > 0) {
+                total.set_rtf((total.rtf() * total.n_decoders() + model_status.rtf() * model_status.n_decoders()) / n_decoders);
+            }
+            total.set_n_decoders(n_decoders);
+            total.set_free_decoders(total.free_decoders() + model_status.free_decoders());
+            total.set_busy_decoders(total.busy_decoders() + model_status.busy_decoders());
+            total.set_waiting_requests(total.waiting_requests() + model_status.waiting_requests());
+            total.set_wait_estimate(std::min(total.wait_estimate(), model_status.wait_estimate()));
+            total.set_loaded(total.loaded() || model_status.loaded());
+            total.set_memory(total.memory() + model_status.memory());
+            total.set_loads(total.loads() + model_status.loads());
+            total.set_evictions(total.evictions() + model_status.evictions());
+            total.set_load_time(std::max(total.load_time(), model_status.load_time()));
+        }
+    }
+
+    response->set_serving(serving);
+    response->set_resident_memory(resident_memory);
+    response->set_active_requests(active_requests);
+    for (auto const &entry : models) {
+        *response->add_models() = entry.second;
+    }
+}
+
+void ReplicaSet::poll_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        for (auto const &replica : replicas_) {
+            // the replica is polled without holding the lock (requests keep being routed)
+            lock.unlock();
+            grpc::ClientContext context;
+            context.set_deadline(std::chrono::system_clock::now() + poll_interval_);
+            kaldi_serve::StatusRequest request;
+            kaldi_serve::StatusResponse response;
+            const grpc::Status status = replica->stub->GetStatus(&context, request, &response);
+            lock.lock();
+
+            const bool was_serving = replica->serving;
+            replica->serving = status.ok() && response.serving();
+            replica->models.clear();
+            replica->n_routed = 0;
+
+            if (!replica->serving) {
+                if (was_serving) std::cout << ":: Replica " << replica->address << " is not serving" << ENDL;
+                continue;
+            }
+
+            replica->resident_memory = response.resident_memory();
+            replica->active_requests = response.active_requests();
+            for (auto const &model_status : response.models()) {
+                replica->models[std::make_pair(model_status.model(), model_status.language_code())] = model_status;
+            }
+            if (!was_serving) {
+                std::cout << ":: Replica " << replica->address << " is serving "
+                          << replica->models.size() << " models" << ENDL;
+            }
+        }
+        cond_.wait_for(lock, poll_interval_);
+    }
+}
+
+
+// RouterImpl ::
+// Forwards the requests of the KaldiServe service to the replicas hosting the
+// requested models, so that each server only needs to load a subset of them.
+// Deadlines and cancellation of the incoming calls carry over to the replicas.
+class RouterImpl final : public kaldi_serve::KaldiServe::Service {
+
+  private:
+    ReplicaSet replicas_;
+
+    // Picks the replica for a request, failing if no (serving) replica hosts its model.
+    grpc::Status route_(const kaldi_serve::RecognitionConfig &config, Replica *&replica);
+
+  public:
+    RouterImpl(const std::vector<std::string> &addresses, const std::chrono::milliseconds &poll_interval);
+
+    grpc::Status Recognize(grpc::ServerContext *const,
+                           const kaldi_serve::RecognizeRequest *const,
+                           kaldi_serve::RecognizeResponse *const) override;
+
+    grpc::Status StreamingRecognize(grpc::ServerContext *const,
+                                    grpc::ServerReader<kaldi_serve::RecognizeRequest> *const,
+                                    kaldi_serve::RecognizeResponse *const) override;
+
+    grpc::Status BidiStreamingRecognize(grpc::ServerContext *const,
+                                        grpc::ServerReaderWriter<kaldi_serve::RecognizeResponse, kaldi_serve::RecognizeRequest> *const) override;
+
+    grpc::Status BatchRecognize(grpc::ServerContext *const,
+                                const kaldi_serve::BatchRecognizeRequest *const,
+                                kaldi_serve::BatchRecognizeResponse *const) override;
+
+    grpc::Status RecognizeManifest(grpc::ServerContext *const,
+                                   const kaldi_serve::ManifestRecognizeRequest *const,
+                                   grpc::ServerWriter<kaldi_serve::ManifestRecognizeResponse> *const) override;
+
+    // Routed by the first model (the replica is expected to host all of them)
+    grpc::Status MultiRecognize(grpc::ServerContext *const,
+                                const kaldi_serve::MultiRecognizeRequest *const,
+                                kaldi_serve::MultiRecognizeResponse *const) override;
+
+    // Reports the combined load of the replicas (per model)
+    grpc::Status GetStatus(grpc::ServerContext *const,
+                           const kaldi_serve::StatusRequest *const,
+                           kaldi_serve::StatusResponse *const) override;
+};
+
+RouterImpl::RouterImpl(const std::vector<std::string> &addresses, const std::chrono::milliseconds &poll_interval)
+    : replicas_(addresses, poll_interval) {}
+
+grpc::Status RouterImpl::route_(const kaldi_serve::RecognitionConfig &config, Replica *&replica) {
+    const model_id_t model_id = std::make_pair(config.model(), config.language_code());
+
+    replica = replicas_.pick(model_id);
+    if (replica == nullptr) {
+        return grpc::Status(grpc::StatusCode::UNAVAILABLE, "No replica serving model " + config.model() + " (" + config.language_code() + ")");
+    }
+    if (DEBUG) std::cout << "[" << timestamp_now() << "] routing " << config.model() << " (" << config.language_code() << ") to " << replica->address << ENDL;
+    return grpc::Status::OK;
+}
+
+grpc::Status RouterImpl::Recognize(grpc::ServerContext *const context,
+                                   const kaldi_serve::RecognizeRequest *const request,
+                                   kaldi_serve::RecognizeResponse *const response) {
+    Replica *replica;
+    grpc::Status route_status = route_(request->config(), replica);
+    if (!route_status.ok()) return route_status;
+
+    std::unique_ptr<grpc::ClientContext> client_context = grpc::ClientContext::FromServerContext(*context);
+    return replica->stub->Recognize(client_context.get(), *request, response);
+}
+
+grpc::Status RouterImpl::StreamingRecognize(grpc::ServerContext *const context,
+                                            grpc::ServerReader<kaldi_serve::RecognizeRequest> *const reader,
+                                            kaldi_serve::RecognizeResponse *const response) {
+    // the first request's config decides the replica
+    kaldi_serve::RecognizeRequest request;
+    if (!reader->Read(&request)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Empty request stream");
+    }
+
+    Replica *replica;
+    grpc::Status route_status = route_(request.config(), replica);
+    if (!route_status.ok()) return route_status;
+
+    std::unique_ptr<grpc::ClientContext> client_context = grpc::ClientContext::FromServerContext(*context);
+    std::unique_ptr<grpc::ClientWriter<kaldi_serve::RecognizeRequest>> upstream =
+        replica->stub->StreamingRecognize(client_context.get(), response);
+
+    // a failed write means the replica ended the call, its status says why
+    bool forwarding = upstream->Write(request);
+    while (forwarding && reader->Read(&request)) {
+        forwarding = upstream->Write(request);
+    }
+    upstream->WritesDone();
+    return upstream->Finish();
+}
+
+grpc::Status RouterImpl::BidiStreamingRecognize(grpc::ServerContext *const context,
+                                                grpc::ServerReaderWriter<kaldi_serve::RecognizeResponse, kaldi_serve::RecognizeRequest> *const stream) {
+    // the first request's config decides the replica
+    kaldi_serve::RecognizeRequest request;
+    if (!stream->Read(&request)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Empty request stream");
+    }
+
+    Replica *replica;
+    grpc::Status route_status = route_(request.config(), replica);
+    if (!route_status.ok()) return route_status;
+
+    std::unique_ptr<grpc::ClientContext> client_context = grpc::ClientContext::FromServerContext(*context);
+    std::unique_ptr<grpc::ClientReaderWriter<kaldi_serve::RecognizeRequest, kaldi_serve::RecognizeResponse>> upstream =
+        replica->stub->BidiStreamingRecognize(client_context.get());
+
+    // responses are relayed on a thread of their own while the requests are forwarded
+    std::thread relay([&]() {
+        kaldi_serve::RecognizeResponse response;
+        while (upstream->Read(&response)) {
+            if (!stream->Write(response)) {
+                client_context->TryCancel();
+                break;
+            }
+        }
+    });
+
+    bool forwarding = upstream->Write(request);
+    while (forwarding && stream->Read(&request)) {
+        forwarding = upstream->Write(request);
+    }
+    upstream->WritesDone();
+    relay.join();
+
+    return upstream->Finish();
+}
+
+grpc::Status RouterImpl::BatchRecognize(grpc::ServerContext *const context,
+                                        const kaldi_serve::BatchRecognizeRequest *const request,
+                                        kaldi_serve::BatchRecognizeResponse *const response) {
+    Replica *replica;
+    grpc::Status route_status = route_(request->config(), replica);
+    if (!route_status.ok()) return route_status;
+
+    std::unique_ptr<grpc::ClientContext> client_context = grpc::ClientContext::FromServerContext(*context);
+    return replica->stub->BatchRecognize(client_context.get(), *request, response);
+}
+
+grpc::Status RouterImpl::RecognizeManifest(grpc::ServerContext *const context,
+                                           const kaldi_serve::ManifestRecognizeRequest *const request,
+                                           grpc::ServerWriter<kaldi_serve::ManifestRecognizeResponse> *const writer) {
+    Replica *replica;
+    grpc::Status route_status = route_(request->config(), replica);
+    if (!route_status.ok()) return route_status;
+
+    std::unique_ptr<grpc::ClientContext> client_context = grpc::ClientContext::FromServerContext(*context);
+    std::unique_ptr<grpc::ClientReader<kaldi_serve::ManifestRecognizeResponse>> upstream =
+        replica->stub->RecognizeManifest(client_context.get(), *request);
+
+    kaldi_serve::ManifestRecognizeResponse response;
+    while (upstream->Read(&response)) {
+        if (!writer->Write(response)) {
+            client_context->TryCancel();
+            break;
+        }
+    }
+    return upstream->Finish();
+}
+
+grpc::Status RouterImpl::MultiRecognize(grpc::ServerContext *const context,
+                                        const kaldi_serve::MultiRecognizeRequest *const request,
+                                        kaldi_serve::MultiRecognizeResponse *const response) {
+    if (request->models_size() == 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "No models to recognize with");
+    }
+
+    kaldi_serve::RecognitionConfig config;
+    config.set_model(request->models(0).model());
+    config.set_language_code(request->models(0).language_code());
+
+    Replica *replica;
+    grpc::Status route_status = route_(config, replica);
+    if (!route_status.ok()) return route_status;
+
+    std::unique_ptr<grpc::ClientContext> client_context = grpc::ClientContext::FromServerContext(*context);
+    return replica->stub->MultiRecognize(client_context.get(), *request, response);
+}
+
+grpc::Status RouterImpl::GetStatus(grpc::ServerContext *const context,
+                                   const kaldi_serve::StatusRequest *const request,
+                                   kaldi_serve::StatusResponse *const response) {
+    replicas_.status(response);
+    return grpc::Status::OK;
+}
+
+// Runs the Router Service
+void run_router(const std::string &address,
+                const std::vector<std::string> &replica_addresses,
+                const std::chrono::milliseconds &poll_interval) {
+    RouterImpl service(replica_addresses, poll_interval);
+
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(address, grpc::InsecureServerCredentials());
+    builder.RegisterService(&service);
+
+    std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
+
+    std::cout << "kaldi-serve gRPC Router listening on " << address << ENDL;
+    server->Wait();
+}
\ No newline at end of file
@@ -8,15 +8,33 @@
 #include <string>
 #include <exception>
 #include <chrono>
+#include <future>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <queue>
+#include <fstream>
+#include <iterator>
+#include <condition_variable>
+#include <thread>
+#include <csignal>
+#include <cstring>
+
+// unix includes
+#include <pthread.h>
 
 // lib includes
 #include <kaldiserve/decoder.hpp>
+#include <kaldiserve/feature.hpp>
+#include <kaldiserve/worker.hpp>
 
 // kaldi includes
 #include <base/kaldi-error.h>
 
 // gRPC inludes
 #include <grpc/grpc.h>
+#include <grpcpp/health_check_service_interface.h>
 #include <grpcpp/security/server_credentials.h>
 #include <grpcpp/server.h>
 #include <grpcpp/server_builder.h>
@@ -24,6 +42,9 @@
 
 // local includes
 #include "config.hpp"
+#include "model_store.hpp"
+#include "session.hpp"
+#include "job.hpp"
 #include "kaldi_serve.grpc.pb.h"
 
 using namespace kaldiserve;
@@ -31,9 +52,11 @@ using namespace kaldiserve;
 
 void add_alternatives_to_response(const utterance_results_t &results,
                                   kaldi_serve::RecognizeResponse *response,
-                                  const kaldi_serve::RecognitionConfig &config) noexcept {
+                                  const kaldi_serve::RecognitionConfig &config,
+                                  const int &channel_tag = 0) noexcept {
 
     kaldi_serve::SpeechRecognitionResult *sr_result = response->add_results();
+    if (channel_tag > 0) sr_result->set_channel_tag(channel_tag);
     kaldi_serve::SpeechRecognitionAlternative *alternative;
     kaldi_serve::Word *word;
 
@@ -45,6 +68,7 @@ void add_alternatives_to_response(const utterance_results_t &results,
             alternative->set_confidence(res.confidence);
             alternative->set_am_score(res.am_score);
             alternative->set_lm_score(res.lm_score);
+            alternative->set_stable_words(res.stable_words);
             if (config.word_level()) {
                 for (auto const &w: res.words) {
                     word = alternative->add_words();
@@ -59,22 +83,202 @@ void add_alternatives_to_response(const utterance_results_t &results,
 }
 
 
+// Compacts a bidi partial response against the previous partial, whose transcripts
+// are kept in `previous`. Returns false when the hypotheses haven't changed, i.e.
+// there's nothing worth sending. With `diff`, every alternative only carries the words
+// following the prefix it shares with the previous partial's (`diff_offset` words).
+bool compact_partial_response(kaldi_serve::RecognizeResponse &response,
+                              std::vector<std::string> &previous,
+                              const bool &diff) noexcept {
+    std::vector<std::string> transcripts;
+    for (auto const &result : response.results()) {
+        for (auto const &alternative : result.alternatives()) {
+            transcripts.push_back(alternative.transcript());
+        }
+    }
+
+    if (transcripts == previous) return false;
+
+    if (diff && response.results_size() > 0) {
+        auto &alternatives = *response.mutable_results(0)->mutable_alternatives();
+        for (int a = 0; a < alternatives.size(); a++) {
+            std::vector<std::string> words, previous_words;
+            std::string word;
+
+            std::stringstream transcript_stream(transcripts[a]);
+            while (transcript_stream >> word) words.push_back(word);
+            std::stringstream previous_stream(static_cast<std::size_t>(a) < previous.size() ? previous[a] : "");
+            while (previous_stream >> word) previous_words.push_back(word);
+
+            std::size_t n_shared = 0;
+            while (n_shared < words.size() && n_shared < previous_words.size() &&
+                   words[n_shared] == previous_words[n_shared]) {
+                n_shared++;
+            }
+
+            std::string suffix;
+            std::vector<std::string> suffix_words(words.begin() + n_shared, words.end());
+            string_join(suffix_words, " ", suffix);
+
+            auto &alternative = alternatives[a];
+            alternative.set_transcript(suffix);
+            alternative.set_diff_offset(n_shared);
+            // (word details may be missing, e.g. without word level results)
+            const int n_trimmed = std::min<int>(alternative.words_size(), static_cast<int>(n_shared));
+            if (n_trimmed > 0) alternative.mutable_words()->DeleteSubrange(0, n_trimmed);
+        }
+    }
+
+    previous.swap(transcripts);
+    return true;
+}
+
+
+// Priority class of a request, `default_priority` is used when unspecified.
+Priority request_priority(const kaldi_serve::RecognitionConfig &config,
+                          const Priority &default_priority) noexcept {
+    switch (config.priority()) {
+        case kaldi_serve::RecognitionConfig::REALTIME:
+            return REALTIME;
+        case kaldi_serve::RecognitionConfig::BATCH:
+            return BATCH;
+        default:
+            return default_priority;
+    }
+}
+
+
+// Defaults of the MultiRecognize race options
+static const float RACE_MARGIN = 1.0;
+static const float RACE_MIN_SECS = 1.0;
+static const float RACE_INTERVAL = 0.5;
+
+
+// Reads the local audio file a `uri` points to, resolved under `audio_root`.
+// Uris are refused when the server has no audio root, and may not step out of it.
+grpc::Status read_audio_uri(const std::string &uri,
+                            const std::string &audio_root,
+                            std::string &content) {
+    if (audio_root.empty()) {
+        return grpc::Status(grpc::StatusCode::PERMISSION_DENIED, "Audio uris are not enabled on the server");
+    }
+
+    std::string path = uri.compare(0, 7, "file://") == 0 ? uri.substr(7) : uri;
+    path.erase(0, path.find_first_not_of('/'));
+
+    std::stringstream path_stream(path);
+    std::string component;
+    while (std::getline(path_stream, component, '/')) {
+        if (component == "..") {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Audio uri " + uri + " refers to a parent directory");
+        }
+    }
+
+    std::ifstream file(join_path(audio_root, path), std::ios::binary);
+    if (!file) {
+        return grpc::Status(grpc::StatusCode::NOT_FOUND, "Audio " + uri + " not found");
+    }
+    content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return grpc::Status::OK;
+}
+
+
+// Reads the audio of a request, either its inline `content` or its `uri`.
+grpc::Status read_audio(const kaldi_serve::RecognitionAudio &audio,
+                        const std::string &audio_root,
+                        std::string &content) {
+    if (audio.audio_source_case() == kaldi_serve::RecognitionAudio::kUri) {
+        return read_audio_uri(audio.uri(), audio_root, content);
+    }
+    content = audio.content();
+    return grpc::Status::OK;
+}
+
+
+// Status of a request refused while the server drains (clients may retry elsewhere).
+grpc::Status draining_status() noexcept {
+    return grpc::Status(grpc::StatusCode::UNAVAILABLE, "Server is shutting down");
+}
+
+
+// Status of a request whose decoding got interrupted before completion.
+grpc::Status interrupted_status(grpc::ServerContext *const context) noexcept {
+    if (context->IsCancelled()) {
+        return grpc::Status(grpc::StatusCode::CANCELLED, "Request cancelled by the client");
+    }
+    return grpc::Status(grpc::StatusCode::DEADLINE_EXCEEDED, "Deadline exceeded while decoding");
+}
+
+
 // KaldiServeImpl ::
 // Defines the core server logic and request/response handlers.
 // Keeps `Decoder` instances cached in a thread-safe
 // multiple producer multiple consumer queue to handle each
 // request with a separate `Decoder`.
+// Decoding itself runs on a dedicated worker pool (if configured)
+// so that gRPC threads only handle network I/O.
 class KaldiServeImpl final : public kaldi_serve::KaldiServe::Service {
 
   private:
-    // Map of Thread-safe Decoder MPMC Queues for diff languages/models
-    std::unordered_map<model_id_t, std::unique_ptr<DecoderQueue>, model_id_hash> decoder_queue_map_;
+    // Thread-safe Decoder MPMC Queues for diff languages/models (loaded eagerly or on demand)
+    std::unique_ptr<ModelStore> model_store_;
+
+    // Pool of decode worker threads (runs on handler threads if empty)
+    std::unique_ptr<WorkerPool> worker_pool_;
+
+    // Decoders of dropped bidi streams awaiting reconnection
+    // (declared after the queues so it is destroyed before them)
+    std::unique_ptr<SessionStore> session_store_;
+
+    // Progress of manifest jobs (for resuming them)
+    std::unique_ptr<JobStore> job_store_;
+
+    // Directory audio uris are resolved under
+    std::string audio_root_;
+
+    // Active requests, new ones are refused once draining
+    std::mutex requests_mutex_;
+    std::condition_variable requests_cond_;
+    std::size_t n_active_requests_;
+    bool draining_;
+
+    // Counts a request as active, returns false (not counting it) when draining.
+    bool begin_request_() noexcept;
 
-    // Tells if a given model name and language code is available for use.
-    inline bool is_model_present(const model_id_t &) const noexcept;
+    // Marks an active request as finished.
+    void end_request_() noexcept;
+
+    // Keeps a request handler counted as active while in scope.
+    class ActiveRequest final {
+      public:
+        explicit ActiveRequest(KaldiServeImpl *const service) noexcept
+            : service_(service), admitted_(service->begin_request_()) {}
+
+        ~ActiveRequest() noexcept {
+            if (admitted_) service_->end_request_();
+        }
+
+        inline bool admitted() const noexcept {
+            return admitted_;
+        }
+
+      private:
+        KaldiServeImpl *const service_;
+        const bool admitted_;
+    };
+
+    // Decodes the channels of a (non-streaming) multi-channel recording
+    // concurrently, each on its own decoder from the model's queue.
+    grpc::Status recognize_channels_(grpc::ServerContext *const,
+                                     const kaldi_serve::RecognizeRequest *const,
+                                     kaldi_serve::RecognizeResponse *const);
 
   public:
-    explicit KaldiServeImpl(const std::vector<ModelSpec> &) noexcept;
+    explicit KaldiServeImpl(const std::vector<ModelSpec> &, const ServerSpec &) noexcept;
+
+    // Stops taking new requests and waits (up to the timeout) for the active ones
+    // to finish. Returns true if all of them finished in time.
+    bool drain(const std::chrono::milliseconds &timeout) noexcept;
 
     // Non-Streaming Request Handler RPC service
     // Accepts a single `RecognizeRequest` message
@@ -95,22 +299,79 @@ class KaldiServeImpl final : public kaldi_serve::KaldiServe::Service {
     // Returns a stream of `RecognizeResponse` messages
     grpc::Status BidiStreamingRecognize(grpc::ServerContext *const,
                                         grpc::ServerReaderWriter<kaldi_serve::RecognizeResponse, kaldi_serve::RecognizeRequest>*) override;
+
+    // Batch Request Handler RPC service
+    // Accepts a single `BatchRecognizeRequest` message
+    // Returns a single `BatchRecognizeResponse` message
+    grpc::Status BatchRecognize(grpc::ServerContext *const,
+                                const kaldi_serve::BatchRecognizeRequest *const,
+                                kaldi_serve::BatchRecognizeResponse *const) override;
+
+    // Manifest Request Handler RPC service
+    // Accepts a single `ManifestRecognizeRequest` message
+    // Returns a stream of `ManifestRecognizeResponse` messages (one per file)
+    grpc::Status RecognizeManifest(grpc::ServerContext *const,
+                                   const kaldi_serve::ManifestRecognizeRequest *const,
+                                   grpc::ServerWriter<kaldi_serve::ManifestRecognizeResponse> *const) override;
+
+    // Multi Model Request Handler RPC service
+    // Accepts a single `MultiRecognizeRequest` message
+    // Returns a single `MultiRecognizeResponse` message (one result per model)
+    grpc::Status MultiRecognize(grpc::ServerContext *const,
+                                const kaldi_serve::MultiRecognizeRequest *const,
+                                kaldi_serve::MultiRecognizeResponse *const) override;
+
+    // Status Request Handler RPC service
+    // Accepts a `StatusRequest` message
+    // Returns the server's load as a `StatusResponse` message
+    grpc::Status GetStatus(grpc::ServerContext *const,
+                           const kaldi_serve::StatusRequest *const,
+                           kaldi_serve::StatusResponse *const) override;
 };
 
-KaldiServeImpl::KaldiServeImpl(const std::vector<ModelSpec> &model_specs) noexcept {
-    for (auto const &model_spec : model_specs) {
-        model_id_t model_id = std::make_pair(model_spec.name, model_spec.language_code);
-        decoder_queue_map_[model_id] = std::unique_ptr<DecoderQueue>(new DecoderQueue(model_spec));
-    }
+KaldiServeImpl::KaldiServeImpl(const std::vector<ModelSpec> &model_specs, const ServerSpec &server_spec) noexcept
+    : n_active_requests_(0), draining_(false) {
+    const std::size_t memory_budget = static_cast<std::size_t>(server_spec.memory_budget * (1 << 30));
+    model_store_ = std::unique_ptr<ModelStore>(new ModelStore(model_specs, server_spec.lazy_load, memory_budget));
+
+    worker_pool_ = std::unique_ptr<WorkerPool>(new WorkerPool(server_spec.n_workers, server_spec.pin_workers));
+
+    const std::chrono::milliseconds session_ttl(static_cast<int64>(server_spec.session_ttl * 1000));
+    session_store_ = std::unique_ptr<SessionStore>(new SessionStore(session_ttl));
+
+    const std::chrono::milliseconds job_ttl(static_cast<int64>(server_spec.job_ttl * 1000));
+    job_store_ = std::unique_ptr<JobStore>(new JobStore(job_ttl));
+    audio_root_ = server_spec.audio_root;
+}
+
+bool KaldiServeImpl::begin_request_() noexcept {
+    std::lock_guard<std::mutex> lock(requests_mutex_);
+    if (draining_) return false;
+    n_active_requests_++;
+    return true;
 }
 
-inline bool KaldiServeImpl::is_model_present(const model_id_t &model_id) const noexcept {
-    return decoder_queue_map_.find(model_id) != decoder_queue_map_.end();
+void KaldiServeImpl::end_request_() noexcept {
+    std::lock_guard<std::mutex> lock(requests_mutex_);
+    n_active_requests_--;
+    requests_cond_.notify_all();
+}
+
+bool KaldiServeImpl::drain(const std::chrono::milliseconds &timeout) noexcept {
+    std::unique_lock<std::mutex> lock(requests_mutex_);
+    draining_ = true;
+    if (n_active_requests_ > 0) {
+        std::cout << ":: Waiting for " << n_active_requests_ << " active requests to finish" << ENDL;
+    }
+    return requests_cond_.wait_for(lock, timeout, [this]() { return n_active_requests_ == 0; });
 }
 
 grpc::Status KaldiServeImpl::Recognize(grpc::ServerContext *const context,
                                        const kaldi_serve::RecognizeRequest *const request,
                                        kaldi_serve::RecognizeResponse *const response) {
+    ActiveRequest active_request(this);
+    if (!active_request.admitted()) return draining_status();
+
     const kaldi_serve::RecognitionConfig config = request->config();
     std::string uuid = request->uuid();
     const int32 n_best = config.max_alternatives();
@@ -118,11 +379,24 @@ grpc::Status KaldiServeImpl::Recognize(grpc::ServerContext *const context,
     const std::string model_name = config.model();
     const std::string language_code = config.language_code();
     const model_id_t model_id = std::make_pair(model_name, language_code);
-
-    if (!is_model_present(model_id)) {
-        return grpc::Status(grpc::StatusCode::NOT_FOUND, "Model " + model_name + " (" + language_code + ") not found");
+    const Priority priority = request_priority(config, BATCH);
+
+    // Model Loading ::
+    // - Lazily loaded models are loaded by their first request (others wait for it).
+    std::shared_ptr<DecoderQueue> decoder_queue;
+    grpc::Status model_status = model_store_->get(model_id, decoder_queue);
+    if (!model_status.ok()) return model_status;
+
+    // multi-channel audio is either decoded per channel or (for raw audio,
+    // whose samples are interleaved) reduced to its first channel
+    if (config.enable_separate_recognition_per_channel() || (config.raw() && config.audio_channel_count() > 1)) {
+        return recognize_channels_(context, request, response);
     }
 
+    std::string content;
+    grpc::Status audio_status = read_audio(request->audio(), audio_root_, content);
+    if (!audio_status.ok()) return audio_status;
+
     std::chrono::system_clock::time_point start_time;
     if (DEBUG) start_time = std::chrono::system_clock::now();
 
@@ -130,7 +404,7 @@ grpc::Status KaldiServeImpl::Recognize(grpc::ServerContext *const context,
     // - Tries to attain lock and obtain decoder from the queue.
     // - Waits here until lock on queue is attained.
     // - Each new audio stream gets separate decoder object.
-    Decoder *decoder_ = decoder_queue_map_[model_id]->acquire();
+    Decoder *decoder_ = decoder_queue->acquire(priority);
 
     if (DEBUG) {
         std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
@@ -138,30 +412,48 @@ grpc::Status KaldiServeImpl::Recognize(grpc::ServerContext *const context,
         std::cout << "[" << timestamp_now() << "] uuid: " << uuid << " decoder acquired in: " << ms.count() << "ms" << ENDL;
     }
 
-    kaldi_serve::RecognitionAudio audio = request->audio();
-    std::stringstream input_stream(audio.content());
+    std::stringstream input_stream(content);
+    // raw audio without an explicit size is read whole
+    const int data_bytes = config.data_bytes() > 0 ? config.data_bytes() : content.size();
+
+    // requests may override the model's (possibly tuned) chunk size
+    const float chunk_size = config.chunk_size() != 0 ? config.chunk_size() : decoder_queue->chunk_size();
 
     if (DEBUG) start_time = std::chrono::system_clock::now();
     decoder_->start_decoding(uuid);
 
+    // stop decoding as soon as the client goes away or its deadline passes
+    decoder_->set_deadline(context->deadline());
+    decoder_->set_cancel_check([context]() { return context->IsCancelled(); });
+
     // decode speech signals in chunks
     try {
-        if (config.raw()) {
-            decoder_->decode_raw_wav_audio(input_stream, sample_rate_hertz, config.data_bytes());
-        } else {
-            decoder_->decode_wav_audio(input_stream);
-        }
+        worker_pool_->run([&]() {
+            if (config.raw()) {
+                decoder_->decode_raw_wav_audio(input_stream, sample_rate_hertz, data_bytes, chunk_size);
+            } else {
+                decoder_->decode_wav_audio(input_stream, chunk_size);
+            }
+        }, decoder_->numa_node(), priority);
     } catch (kaldi::KaldiFatalError &e) {
-        decoder_queue_map_[model_id]->release(decoder_);
+        decoder_queue->release(decoder_);
         std::string message = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
         return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
     } catch (std::exception &e) {
-        decoder_queue_map_[model_id]->release(decoder_);
+        decoder_queue->release(decoder_);
         return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
     }
 
+    if (decoder_->cancelled()) {
+        decoder_->free_decoder();
+        decoder_queue->release(decoder_);
+        return interrupted_status(context);
+    }
+
     utterance_results_t k_results_;
-    decoder_->get_decoded_results(n_best, k_results_, config.word_level());
+    worker_pool_->run([&]() {
+        decoder_->get_decoded_results(n_best, k_results_, config.word_level());
+    }, decoder_->numa_node(), priority);
 
     add_alternatives_to_response(k_results_, response, config);
 
@@ -169,7 +461,7 @@ grpc::Status KaldiServeImpl::Recognize(grpc::ServerContext *const context,
     // - Releases the lock on the decoder and pushes back into queue.
     // - Notifies another request handler thread of availability.
     decoder_->free_decoder();
-    decoder_queue_map_[model_id]->release(decoder_);
+    decoder_queue->release(decoder_);
 
     if (DEBUG) {
         std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
@@ -181,9 +473,148 @@ grpc::Status KaldiServeImpl::Recognize(grpc::ServerContext *const context,
     return grpc::Status::OK;
 }
 
+grpc::Status KaldiServeImpl::recognize_channels_(grpc::ServerContext *const context,
+                                                 const kaldi_serve::RecognizeRequest *const request,
+                                                 kaldi_serve::RecognizeResponse *const response) {
+    const kaldi_serve::RecognitionConfig config = request->config();
+    std::string uuid = request->uuid();
+    const int32 n_best = config.max_alternatives();
+    const model_id_t model_id = std::make_pair(config.model(), config.language_code());
+    const Priority priority = request_priority(config, BATCH);
+
+    std::shared_ptr<DecoderQueue> decoder_queue;
+    grpc::Status model_status = model_store_->get(model_id, decoder_queue);
+    if (!model_status.ok()) return model_status;
+
+    std::chrono::system_clock::time_point start_time;
+    if (DEBUG) start_time = std::chrono::system_clock::now();
+
+    // the audio is read once, row `c` of the matrix holds channel `c`
+    kaldi::WaveData wave_data;
+    kaldi::Matrix<kaldi::BaseFloat> raw_data;
+    const kaldi::Matrix<kaldi::BaseFloat> *channel_data;
+    kaldi::BaseFloat samp_freq;
+
+    std::string content;
+    grpc::Status audio_status = read_audio(request->audio(), audio_root_, content);
+    if (!audio_status.ok()) return audio_status;
+
+    std::stringstream input_stream(content);
+    try {
+        if (config.raw()) {
+            const std::size_t raw_channels = std::max(config.audio_channel_count(), 1);
+            const std::size_t data_bytes = config.data_bytes() > 0 ? config.data_bytes() : content.size();
+            read_raw_wav_stream(input_stream, data_bytes, raw_data, raw_channels);
+            channel_data = &raw_data;
+            samp_freq = config.sample_rate_hertz();
+        } else {
+            wave_data.Read(input_stream);
+            channel_data = &wave_data.Data();
+            samp_freq = wave_data.SampFreq();
+        }
+    } catch (kaldi::KaldiFatalError &e) {
+        std::string message = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
+    }
+
+    const std::size_t n_channels = config.enable_separate_recognition_per_channel() ? channel_data->NumRows() : 1;
+    const float chunk_size = config.chunk_size() != 0 ? config.chunk_size() : decoder_queue->chunk_size();
+
+    // Decoder Acquisition ::
+    // - All the channels' decoders are taken from the queue at once.
+    std::vector<Decoder*> decoders;
+    try {
+        decoder_queue->acquire(n_channels, decoders, priority);
+    } catch (kaldi::KaldiFatalError &e) {
+        return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, e.KaldiMessage());
+    }
+
+    if (DEBUG) {
+        std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        std::cout << "[" << timestamp_now() << "] uuid: " << uuid << " " << n_channels << " decoders acquired in: " << ms.count() << "ms" << ENDL;
+    }
+
+    if (DEBUG) start_time = std::chrono::system_clock::now();
+
+    std::vector<utterance_results_t> k_results_(n_channels);
+    std::vector<std::future<void>> channel_futures;
+    channel_futures.reserve(n_channels);
+
+    for (std::size_t c = 0; c < n_channels; c++) {
+        Decoder *decoder_ = decoders[c];
+        decoder_->start_decoding(uuid);
+
+        // stop decoding as soon as the client goes away or its deadline passes
+        decoder_->set_deadline(context->deadline());
+        decoder_->set_cancel_check([context]() { return context->IsCancelled(); });
+
+        auto decode_channel = [&, decoder_, c]() {
+            kaldi::SubVector<kaldi::BaseFloat> channel(*channel_data, c);
+            decoder_->decode_audio(channel, samp_freq, chunk_size);
+            if (!decoder_->cancelled()) {
+                decoder_->get_decoded_results(n_best, k_results_[c], config.word_level());
+            }
+        };
+
+        // channels run concurrently, on their own threads if there is no worker pool
+        if (worker_pool_->size() > 0) {
+            channel_futures.push_back(worker_pool_->submit(decode_channel, decoder_->numa_node(), priority));
+        } else {
+            channel_futures.push_back(std::async(std::launch::async, decode_channel));
+        }
+    }
+
+    // every channel is waited upon before its decoder goes back to the queue
+    grpc::Status status = grpc::Status::OK;
+    for (auto &channel_future : channel_futures) {
+        try {
+            channel_future.get();
+        } catch (kaldi::KaldiFatalError &e) {
+            std::string message = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
+            if (status.ok()) status = grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
+        } catch (std::exception &e) {
+            if (status.ok()) status = grpc::Status(grpc::StatusCode::INTERNAL, e.what());
+        }
+    }
+
+    bool cancelled = false;
+    for (auto const &decoder_ : decoders) {
+        cancelled = cancelled || decoder_->cancelled();
+    }
+
+    if (status.ok() && !cancelled) {
+        for (std::size_t c = 0; c < n_channels; c++) {
+            // channel tags start at 1, a reduced (single channel) request is left untagged
+            add_alternatives_to_response(k_results_[c], response, config,
+                                         config.enable_separate_recognition_per_channel() ? c + 1 : 0);
+        }
+    }
+
+    // Decoder Release ::
+    // - Releases the decoders and pushes them back into queue.
+    for (auto const &decoder_ : decoders) {
+        decoder_->free_decoder();
+        decoder_queue->release(decoder_);
+    }
+
+    if (status.ok() && cancelled) return interrupted_status(context);
+
+    if (DEBUG) {
+        std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        std::cout << "[" << timestamp_now() << "] uuid: " << uuid << " request resolved in: " << ms.count() << "ms" << ENDL;
+    }
+
+    return status;
+}
+
 grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const context,
                                                 grpc::ServerReader<kaldi_serve::RecognizeRequest> *const reader,
                                                 kaldi_serve::RecognizeResponse *const response) {
+    ActiveRequest active_request(this);
+    if (!active_request.admitted()) return draining_status();
+
     kaldi_serve::RecognizeRequest request_;
     reader->Read(&request_);
 
@@ -196,10 +627,13 @@ grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const conte
     const std::string model_name = config.model();
     const std::string language_code = config.language_code();
     const model_id_t model_id = std::make_pair(model_name, language_code);
+    const Priority priority = request_priority(config, REALTIME);
 
-    if (!is_model_present(model_id)) {
-        return grpc::Status(grpc::StatusCode::NOT_FOUND, "Model " + model_name + " (" + language_code + ") not found");
-    }
+    // Model Loading ::
+    // - Lazily loaded models are loaded by their first request (others wait for it).
+    std::shared_ptr<DecoderQueue> decoder_queue;
+    grpc::Status model_status = model_store_->get(model_id, decoder_queue);
+    if (!model_status.ok()) return model_status;
 
     std::chrono::system_clock::time_point start_time, start_time_req;
     if (DEBUG) start_time = std::chrono::system_clock::now();
@@ -208,7 +642,7 @@ grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const conte
     // - Tries to attain lock and obtain decoder from the queue.
     // - Waits here until lock on queue is attained.
     // - Each new audio stream gets separate decoder object.
-    Decoder *decoder_ = decoder_queue_map_[model_id]->acquire();
+    Decoder *decoder_ = decoder_queue->acquire(priority);
 
     if (DEBUG) {
         std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
@@ -222,6 +656,10 @@ grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const conte
     if (DEBUG) start_time_req = std::chrono::system_clock::now();
     decoder_->start_decoding(uuid);
 
+    // stop decoding as soon as the client goes away or its deadline passes
+    decoder_->set_deadline(context->deadline());
+    decoder_->set_cancel_check([context]() { return context->IsCancelled(); });
+
     // read chunks until end of stream
     do {
         if (DEBUG) {
@@ -252,17 +690,19 @@ grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const conte
         // decode intermediate speech signals
         // Assuming: audio stream has already been chunked into desired length
         try {
-            if (config.raw()) {
-                decoder_->decode_stream_raw_wav_chunk(input_stream_chunk, sample_rate_hertz, config.data_bytes());
-            } else {
-                decoder_->decode_stream_wav_chunk(input_stream_chunk);
-            }
+            worker_pool_->run([&]() {
+                if (config.raw()) {
+                    decoder_->decode_stream_raw_wav_chunk(input_stream_chunk, sample_rate_hertz, config.data_bytes());
+                } else {
+                    decoder_->decode_stream_wav_chunk(audio.content().data(), audio.content().size());
+                }
+            }, decoder_->numa_node(), priority);
         } catch (kaldi::KaldiFatalError &e) {
-            decoder_queue_map_[model_id]->release(decoder_);
+            decoder_queue->release(decoder_);
             std::string message = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
             return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
         } catch (std::exception &e) {
-            decoder_queue_map_[model_id]->release(decoder_);
+            decoder_queue->release(decoder_);
             return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
         }
 
@@ -280,12 +720,20 @@ grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const conte
 
             std::cout << debug_msg.str() << ENDL;
         }
-    } while (reader->Read(&request_));
+    } while (!decoder_->cancelled() && reader->Read(&request_));
+
+    if (decoder_->cancelled()) {
+        decoder_->free_decoder();
+        decoder_queue->release(decoder_);
+        return interrupted_status(context);
+    }
 
     if (DEBUG) start_time = std::chrono::system_clock::now();
 
     utterance_results_t k_results_;
-    decoder_->get_decoded_results(n_best, k_results_, config.word_level());
+    worker_pool_->run([&]() {
+        decoder_->get_decoded_results(n_best, k_results_, config.word_level());
+    }, decoder_->numa_node(), priority);
 
     add_alternatives_to_response(k_results_, response, config);
 
@@ -293,7 +741,7 @@ grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const conte
     // - Releases the lock on the decoder and pushes back into queue.
     // - Notifies another request handler thread of availability.
     decoder_->free_decoder();
-    decoder_queue_map_[model_id]->release(decoder_);
+    decoder_queue->release(decoder_);
 
     if (DEBUG) {
         std::chrono::system_clock::time_point end_time_req = std::chrono::system_clock::now();
@@ -310,6 +758,9 @@ grpc::Status KaldiServeImpl::StreamingRecognize(grpc::ServerContext *const conte
 
 grpc::Status KaldiServeImpl::BidiStreamingRecognize(grpc::ServerContext *const context,
                                                     grpc::ServerReaderWriter<kaldi_serve::RecognizeResponse, kaldi_serve::RecognizeRequest> *stream) {
+    ActiveRequest active_request(this);
+    if (!active_request.admitted()) return draining_status();
+
     kaldi_serve::RecognizeRequest request_;
     stream->Read(&request_);
 
@@ -322,31 +773,49 @@ grpc::Status KaldiServeImpl::BidiStreamingRecognize(grpc::ServerContext *const c
     const std::string model_name = config.model();
     const std::string language_code = config.language_code();
     const model_id_t model_id = std::make_pair(model_name, language_code);
+    const Priority priority = request_priority(config, REALTIME);
 
-    if (!is_model_present(model_id)) {
-        return grpc::Status(grpc::StatusCode::NOT_FOUND, "Model " + model_name + " (" + language_code + ") not found");
-    }
+    // Model Loading ::
+    // - Lazily loaded models are loaded by their first request (others wait for it).
+    std::shared_ptr<DecoderQueue> decoder_queue;
+    grpc::Status model_status = model_store_->get(model_id, decoder_queue);
+    if (!model_status.ok()) return model_status;
 
     std::chrono::system_clock::time_point start_time, start_time_req;
     if (DEBUG) start_time = std::chrono::system_clock::now();
     
+    // Session Resumption ::
+    // - A stream reconnecting with the `uuid` of a dropped stream continues on its parked decoder.
+    Decoder *decoder_ = uuid.empty() ? nullptr : session_store_->resume(uuid, model_id);
+    const bool resumed = decoder_ != nullptr;
+
     // Decoder Acquisition ::
     // - Tries to attain lock and obtain decoder from the queue.
     // - Waits here until lock on queue is attained.
     // - Each new audio stream gets separate decoder object.
-    Decoder *decoder_ = decoder_queue_map_[model_id]->acquire();
+    if (!resumed) decoder_ = decoder_queue->acquire(priority);
 
     if (DEBUG) {
         std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
         auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
-        std::cout << "[" << timestamp_now() << "] uuid: " << uuid << " decoder acquired in: " << ms.count() << "ms" << ENDL;
+        std::cout << "[" << timestamp_now() << "] uuid: " << uuid << (resumed ? " session resumed" : " decoder acquired") << " in: " << ms.count() << "ms" << ENDL;
     }
 
     int i = 0;
     int bytes = 0;
+    // a resumed stream skips the audio (by its `offset`) taken in before the reconnect
+    bool resuming = resumed;
+    // transcripts of the last partial sent
+    std::vector<std::string> partial_transcripts;
+    // resume offset last sent to the client
+    std::size_t sent_bytes = 0;
 
     if (DEBUG) start_time_req = std::chrono::system_clock::now();
-    decoder_->start_decoding(uuid);
+    if (!resumed) decoder_->start_decoding(uuid);
+
+    // stop decoding as soon as the client goes away or its deadline passes
+    decoder_->set_deadline(context->deadline());
+    decoder_->set_cancel_check([context]() { return context->IsCancelled(); });
 
     // read chunks until end of stream
     do {
@@ -372,31 +841,59 @@ grpc::Status KaldiServeImpl::BidiStreamingRecognize(grpc::ServerContext *const c
         }
         config = request_.config();
         kaldi_serve::RecognitionAudio audio = request_.audio();
-        std::stringstream input_stream_chunk(audio.content());
+        const std::string &content = audio.content();
+
+        // bytes of the chunk taken in before the reconnect (at most the whole chunk)
+        std::size_t skip_bytes = 0;
+        if (resuming) {
+            const std::size_t processed_bytes = decoder_->processed_bytes();
+            const std::size_t offset = static_cast<std::size_t>(std::max<int64>(request_.offset(), 0));
+            if (offset < processed_bytes) {
+                skip_bytes = std::min(processed_bytes - offset, content.size());
+            }
+            resuming = skip_bytes == content.size();
+        }
+
+        // partials carry only the best hypothesis unless asked for more
+        const int32 partial_n_best = config.partial_max_alternatives() > 0 ? config.partial_max_alternatives() : 1;
 
         // decode intermediate speech signals
         // Assuming: audio stream has already been chunked into desired length
         try {
-            if (config.raw()) {
-                decoder_->decode_stream_raw_wav_chunk(input_stream_chunk, sample_rate_hertz, config.data_bytes());
-            } else {
-                decoder_->decode_stream_wav_chunk(input_stream_chunk);
-            }
-
             utterance_results_t k_results_;
-            decoder_->get_decoded_results(n_best, k_results_, config.word_level(), true);
+            worker_pool_->run([&]() {
+                if (skip_bytes < content.size()) {
+                    if (config.raw()) {
+                        std::stringstream input_stream_chunk(content.substr(skip_bytes));
+                        decoder_->decode_stream_raw_wav_chunk(input_stream_chunk, sample_rate_hertz, content.size() - skip_bytes);
+                    } else {
+                        decoder_->decode_stream_wav_chunk(content.data() + skip_bytes, content.size() - skip_bytes);
+                    }
+                }
+                decoder_->get_decoded_results(partial_n_best, k_results_, config.word_level(), true, config.stable_words());
+            }, decoder_->numa_node(), priority);
 
             kaldi_serve::RecognizeResponse response_;
             add_alternatives_to_response(k_results_, &response_, config);
-
-            stream->Write(response_);
+            response_.set_processed_bytes(decoder_->processed_bytes());
+
+            // partials are only sent when the hypothesis changes, otherwise a response
+            // without results still tells the client the offset to resume from
+            if (compact_partial_response(response_, partial_transcripts, config.partial_diff())) {
+                stream->Write(response_);
+                sent_bytes = decoder_->processed_bytes();
+            } else if (decoder_->processed_bytes() > sent_bytes) {
+                response_.clear_results();
+                stream->Write(response_);
+                sent_bytes = decoder_->processed_bytes();
+            }
 
         } catch (kaldi::KaldiFatalError &e) {
-            decoder_queue_map_[model_id]->release(decoder_);
+            decoder_queue->release(decoder_);
             std::string message = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
             return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, message);
         } catch (std::exception &e) {
-            decoder_queue_map_[model_id]->release(decoder_);
+            decoder_queue->release(decoder_);
             return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
         }
 
@@ -414,15 +911,32 @@ grpc::Status KaldiServeImpl::BidiStreamingRecognize(grpc::ServerContext *const c
 
             std::cout << debug_msg.str() << ENDL;
         }
-    } while (stream->Read(&request_));
+    } while (!decoder_->cancelled() && stream->Read(&request_));
+
+    if (decoder_->cancelled()) {
+        // only streams cut off by the connection are kept for resumption, a
+        // stream out of time (a deadline also cancels the context) is done
+        const bool deadline_exceeded = std::chrono::system_clock::now() >= context->deadline();
+        if (context->IsCancelled() && !deadline_exceeded && session_store_->enabled() && !uuid.empty()) {
+            // the client may reconnect with the same uuid and continue
+            session_store_->park(uuid, model_id, decoder_, decoder_queue);
+        } else {
+            decoder_->free_decoder();
+            decoder_queue->release(decoder_);
+        }
+        return interrupted_status(context);
+    }
 
     if (DEBUG) start_time = std::chrono::system_clock::now();
 
     utterance_results_t k_results_;
-    decoder_->get_decoded_results(n_best, k_results_, config.word_level());
+    worker_pool_->run([&]() {
+        decoder_->get_decoded_results(n_best, k_results_, config.word_level());
+    }, decoder_->numa_node(), priority);
 
     kaldi_serve::RecognizeResponse response_;
     add_alternatives_to_response(k_results_, &response_, config);
+    response_.set_processed_bytes(decoder_->processed_bytes());
 
     stream->Write(response_);
 
@@ -430,7 +944,7 @@ grpc::Status KaldiServeImpl::BidiStreamingRecognize(grpc::ServerContext *const c
     // - Releases the lock on the decoder and pushes back into queue.
     // - Notifies another request handler thread of availability.
     decoder_->free_decoder();
-    decoder_queue_map_[model_id]->release(decoder_);
+    decoder_queue->release(decoder_);
 
     if (DEBUG) {
         std::chrono::system_clock::time_point end_time_req = std::chrono::system_clock::now();
@@ -446,20 +960,508 @@ grpc::Status KaldiServeImpl::BidiStreamingRecognize(grpc::ServerContext *const c
 }
 
 
+grpc::Status KaldiServeImpl::BatchRecognize(grpc::ServerContext *const context,
+                                            const kaldi_serve::BatchRecognizeRequest *const request,
+                                            kaldi_serve::BatchRecognizeResponse *const response) {
+    ActiveRequest active_request(this);
+    if (!active_request.admitted()) return draining_status();
+
+    const kaldi_serve::RecognitionConfig config = request->config();
+    const int32 n_best = config.max_alternatives();
+    const int32 sample_rate_hertz = config.sample_rate_hertz();
+    const std::string model_name = config.model();
+    const std::string language_code = config.language_code();
+    const model_id_t model_id = std::make_pair(model_name, language_code);
+    const Priority priority = request_priority(config, BATCH);
+    const std::size_t n_items = request->audios_size();
+
+    // Model Loading ::
+    // - Lazily loaded models are loaded by their first request (others wait for it).
+    std::shared_ptr<DecoderQueue> decoder_queue;
+    grpc::Status model_status = model_store_->get(model_id, decoder_queue);
+    if (!model_status.ok()) return model_status;
+
+    std::chrono::system_clock::time_point start_time;
+    if (DEBUG) start_time = std::chrono::system_clock::now();
+
+    const float chunk_size = config.chunk_size() != 0 ? config.chunk_size() : decoder_queue->chunk_size();
+
+    std::vector<utterance_results_t> k_results_(n_items);
+    std::vector<std::string> errors(n_items);
+    std::atomic<bool> cancelled(false);
+
+    // Batch Decoding ::
+    // - Decoders are acquired once for the batch and reused across its utterances.
+    // - Utterances are decoded in parallel on the worker pool.
+    try {
+        decoder_queue->decode_batch(n_items, [&](const std::size_t &i, Decoder *const decoder_) {
+            // an unreadable uri fails its own item, not the batch
+            std::string content;
+            const grpc::Status audio_status = read_audio(request->audios(i), audio_root_, content);
+            if (!audio_status.ok()) {
+                errors[i] = audio_status.error_message();
+                return;
+            }
+            decoder_->start_decoding(i < request->uuids_size() ? request->uuids(i) : "");
+
+            // stop decoding as soon as the client goes away or its deadline passes
+            decoder_->set_deadline(context->deadline());
+            decoder_->set_cancel_check([context]() { return context->IsCancelled(); });
+
+            try {
+                std::stringstream input_stream(content);
+                if (config.raw()) {
+                    decoder_->decode_raw_wav_audio(input_stream, sample_rate_hertz, content.size(), chunk_size);
+                } else {
+                    decoder_->decode_wav_audio(input_stream, chunk_size);
+                }
+                if (!decoder_->cancelled()) {
+                    decoder_->get_decoded_results(n_best, k_results_[i], config.word_level());
+                }
+            } catch (kaldi::KaldiFatalError &e) {
+                errors[i] = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
+            }
+
+            if (decoder_->cancelled()) cancelled = true;
+        }, worker_pool_.get(), priority);
+    } catch (std::exception &e) {
+        return grpc::Status(grpc::StatusCode::INTERNAL, e.what());
+    }
+
+    if (cancelled) return interrupted_status(context);
+
+    for (std::size_t i = 0; i < n_items; i++) {
+        add_alternatives_to_response(k_results_[i], response->add_responses(), config);
+        response->add_errors(errors[i]);
+    }
+
+    if (DEBUG) {
+        std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        std::cout << "[" << timestamp_now() << "] batch of " << n_items << " utterances resolved in: " << ms.count() << "ms" << ENDL;
+    }
+
+    return grpc::Status::OK;
+}
+
+grpc::Status KaldiServeImpl::RecognizeManifest(grpc::ServerContext *const context,
+                                               const kaldi_serve::ManifestRecognizeRequest *const request,
+                                               grpc::ServerWriter<kaldi_serve::ManifestRecognizeResponse> *const writer) {
+    ActiveRequest active_request(this);
+    if (!active_request.admitted()) return draining_status();
+
+    const kaldi_serve::RecognitionConfig config = request->config();
+    const int32 n_best = config.max_alternatives();
+    const int32 sample_rate_hertz = config.sample_rate_hertz();
+    const std::string model_name = config.model();
+    const std::string language_code = config.language_code();
+    const model_id_t model_id = std::make_pair(model_name, language_code);
+    const Priority priority = request_priority(config, BATCH);
+
+    // Model Loading ::
+    // - Lazily loaded models are loaded by their first request (others wait for it).
+    std::shared_ptr<DecoderQueue> decoder_queue;
+    grpc::Status model_status = model_store_->get(model_id, decoder_queue);
+    if (!model_status.ok()) return model_status;
+
+    std::string manifest;
+    grpc::Status status = read_audio(request->manifest(), audio_root_, manifest);
+    if (!status.ok()) return status;
+
+    std::vector<std::string> uris;
+    std::stringstream manifest_stream(manifest);
+    std::string line;
+    while (std::getline(manifest_stream, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) uris.push_back(line);
+    }
+
+    // Job Claim ::
+    // - A resumed job skips the files already streamed back to the client.
+    std::string job_id = request->job_id();
+    std::shared_ptr<ManifestJob> job;
+    status = job_store_->claim(job_id, uris.size(), job);
+    if (!status.ok()) return status;
+
+    // decoders go back to the queue as soon as their file is decoded, so the window
+    // may be wider than the queue (files then just wait for a decoder)
+    const std::size_t max_in_flight = request->max_in_flight() > 0
+                                          ? std::size_t(request->max_in_flight())
+                                          : decoder_queue->n_decoders();
+    const float chunk_size = config.chunk_size() != 0 ? config.chunk_size() : decoder_queue->chunk_size();
+
+    if (DEBUG) {
+        std::cout << "[" << timestamp_now() << "] job: " << job_id << " running " << uris.size() - job->n_done
+                  << " of " << uris.size() << " files" << ENDL;
+    }
+
+    struct ManifestItem {
+        std::size_t index;
+        utterance_results_t results;
+        std::string error;
+    };
+
+    // files finished decoding, waiting to be streamed back
+    std::queue<std::unique_ptr<ManifestItem>> completed;
+    std::mutex completed_mutex;
+    std::condition_variable completed_cond;
+    std::unordered_map<std::size_t, std::future<void>> in_flight;
+
+    std::size_t next = 0;
+    bool interrupted = false;
+
+    while (true) {
+        // Decoding Window ::
+        // - At most `max_in_flight` files are decoded (and waiting to be sent) at a time.
+        while (!interrupted && in_flight.size() < max_in_flight && next < uris.size()) {
+            const std::size_t i = next++;
+            if (job->done[i]) continue;
+
+            // (this thread holds no decoder while waiting here, the files in
+            // flight give theirs back without waiting on it)
+            Decoder *decoder_ = decoder_queue->acquire(priority);
+
+            auto decode_file = [&, i, decoder_]() {
+                std::unique_ptr<ManifestItem> item(new ManifestItem());
+                item->index = i;
+
+                std::string content;
+                grpc::Status audio_status = read_audio_uri(uris[i], audio_root_, content);
+
+                if (!audio_status.ok()) {
+                    item->error = audio_status.error_message();
+                } else {
+                    try {
+                        decoder_->start_decoding(uris[i]);
+
+                        // stop decoding as soon as the client goes away or its deadline passes
+                        decoder_->set_deadline(context->deadline());
+                        decoder_->set_cancel_check([context]() { return context->IsCancelled(); });
+
+                        std::stringstream input_stream(content);
+                        if (config.raw()) {
+                            decoder_->decode_raw_wav_audio(input_stream, sample_rate_hertz, content.size(), chunk_size);
+                        } else {
+                            decoder_->decode_wav_audio(input_stream, chunk_size);
+                        }
+                        if (!decoder_->cancelled()) {
+                            decoder_->get_decoded_results(n_best, item->results, config.word_level());
+                        }
+                    } catch (kaldi::KaldiFatalError &e) {
+                        item->error = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
+                    } catch (std::exception &e) {
+                        item->error = e.what();
+                    }
+                }
+
+                // Decoder Release ::
+                // - The results are copied out, so the decoder goes back to the queue
+                //   right away instead of waiting for the file to be streamed back.
+                decoder_->free_decoder();
+                decoder_queue->release(decoder_);
+
+                std::lock_guard<std::mutex> lock(completed_mutex);
+                completed.push(std::move(item));
+                completed_cond.notify_one();
+            };
+
+            if (worker_pool_->size() > 0) {
+                in_flight[i] = worker_pool_->submit(decode_file, decoder_->numa_node(), priority);
+            } else {
+                in_flight[i] = std::async(std::launch::async, decode_file);
+            }
+        }
+
+        if (in_flight.empty()) break;
+
+        std::unique_ptr<ManifestItem> item;
+        {
+            std::unique_lock<std::mutex> lock(completed_mutex);
+            completed_cond.wait(lock, [&completed]() { return !completed.empty(); });
+            item = std::move(completed.front());
+            completed.pop();
+        }
+        in_flight[item->index].get();
+        in_flight.erase(item->index);
+
+        // the rest of the files in flight only get drained
+        if (interrupted) continue;
+
+        kaldi_serve::ManifestRecognizeResponse result;
+        result.set_job_id(job_id);
+        result.set_index(item->index);
+        result.set_uri(uris[item->index]);
+        result.set_error(item->error);
+        if (item->error.empty()) add_alternatives_to_response(item->results, result.mutable_response(), config);
+
+        // Backpressure ::
+        // - `Write` blocks while the client isn't taking in results (flow control),
+        //   holding back further files from being started.
+        // - Only the files streamed back count as done for the job.
+        if (context->IsCancelled() || !writer->Write(result)) {
+            interrupted = true;
+            continue;
+        }
+        job->done[item->index] = true;
+        job->n_done++;
+    }
+
+    job_store_->unclaim(job_id, job);
+
+    if (interrupted) return interrupted_status(context);
+
+    if (DEBUG) std::cout << "[" << timestamp_now() << "] job: " << job_id << " completed" << ENDL;
+
+    return grpc::Status::OK;
+}
+
+grpc::Status KaldiServeImpl::MultiRecognize(grpc::ServerContext *const context,
+                                            const kaldi_serve::MultiRecognizeRequest *const request,
+                                            kaldi_serve::MultiRecognizeResponse *const response) {
+    ActiveRequest active_request(this);
+    if (!active_request.admitted()) return draining_status();
+
+    const kaldi_serve::RecognitionConfig config = request->config();
+    const std::string uuid = request->uuid();
+    const int32 n_best = config.max_alternatives();
+    const int32 sample_rate_hertz = config.sample_rate_hertz();
+    const Priority priority = request_priority(config, BATCH);
+    const std::size_t n_models = request->models_size();
+
+    if (n_models == 0) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "No models to recognize with");
+    }
+    if (config.enable_separate_recognition_per_channel() || (config.raw() && config.audio_channel_count() > 1)) {
+        return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Multi-channel audio can't be recognized with several models");
+    }
+
+    std::vector<model_id_t> model_ids;
+    for (auto const &model : request->models()) {
+        const model_id_t model_id = std::make_pair(model.model(), model.language_code());
+        if (std::find(model_ids.begin(), model_ids.end(), model_id) != model_ids.end()) {
+            return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Model " + model.model() + " (" + model.language_code() + ") asked for more than once");
+        }
+        model_ids.push_back(model_id);
+    }
+
+    // Model Loading ::
+    // - Lazily loaded models are loaded by their first request (others wait for it).
+    std::vector<std::shared_ptr<DecoderQueue>> decoder_queues(n_models);
+    for (std::size_t i = 0; i < n_models; i++) {
+        grpc::Status model_status = model_store_->get(model_ids[i], decoder_queues[i]);
+        if (!model_status.ok()) return model_status;
+    }
+
+    std::string content;
+    grpc::Status audio_status = read_audio(request->audio(), audio_root_, content);
+    if (!audio_status.ok()) return audio_status;
+
+    std::chrono::system_clock::time_point start_time;
+    if (DEBUG) start_time = std::chrono::system_clock::now();
+
+    // Decoder Acquisition ::
+    // - One decoder per model, acquired in model order so that concurrent
+    //   requests for overlapping models can't hold on to each other's decoders.
+    std::vector<std::size_t> acquire_order(n_models);
+    std::iota(acquire_order.begin(), acquire_order.end(), 0);
+    std::sort(acquire_order.begin(), acquire_order.end(), [&model_ids](const std::size_t &a, const std::size_t &b) {
+        return model_ids[a] < model_ids[b];
+    });
+    std::vector<Decoder*> decoders(n_models);
+    for (auto const &i : acquire_order) decoders[i] = decoder_queues[i]->acquire(priority);
+
+    // models of a feature group share a frontend, the others get one of their own
+    std::vector<std::vector<std::size_t>> groups;
+    std::unordered_map<std::string, std::size_t> group_index;
+    for (std::size_t i = 0; i < n_models; i++) {
+        const std::string &feature_group = decoders[i]->model_spec().feature_group;
+        if (feature_group.empty() || group_index.find(feature_group) == group_index.end()) {
+            if (!feature_group.empty()) group_index[feature_group] = groups.size();
+            groups.push_back({i});
+        } else {
+            groups[group_index[feature_group]].push_back(i);
+        }
+    }
+
+    for (std::size_t i = 0; i < n_models; i++) {
+        kaldi_serve::ModelResult *result = response->add_results();
+        result->set_model(model_ids[i].first);
+        result->set_language_code(model_ids[i].second);
+    }
+
+    // Model Racing ::
+    // - Models trailing the leader get cancelled at the race's checkpoints.
+    std::unique_ptr<DecoderRace> race;
+    if (request->race()) {
+        race.reset(new DecoderRace(decoders,
+                                   request->race_margin() > 0 ? request->race_margin() : RACE_MARGIN,
+                                   request->race_min_secs() > 0 ? request->race_min_secs() : RACE_MIN_SECS,
+                                   request->race_interval() > 0 ? request->race_interval() : RACE_INTERVAL));
+    }
+
+    // raw audio without an explicit size is read whole
+    const int data_bytes = config.data_bytes() > 0 ? config.data_bytes() : content.size();
+    std::vector<float> scores(n_models, -std::numeric_limits<float>::infinity());
+    std::atomic<bool> cancelled(false);
+
+    // Multi Model Decoding ::
+    // - Every group's audio is fed through its frontend chunk by chunk, the
+    //   group's decoders search the new frames in parallel on the worker pool.
+    // - Groups are decoded concurrently, a failing group doesn't fail the others.
+    auto decode_group = [&](const std::vector<std::size_t> &group) {
+        std::vector<Decoder*> group_decoders;
+        for (auto const &i : group) group_decoders.push_back(decoders[i]);
+
+        // the chunk size of the group's first model, unless the request overrides it
+        const float chunk_size = config.chunk_size() != 0 ? config.chunk_size() : decoder_queues[group.front()]->chunk_size();
+
+        std::string error;
+        try {
+            SharedFrontend frontend(group_decoders, uuid);
+            frontend.set_race(race.get());
+
+            // stop decoding as soon as the client goes away or its deadline passes
+            for (auto &decoder_ : group_decoders) {
+                decoder_->set_deadline(context->deadline());
+                decoder_->set_cancel_check([context]() { return context->IsCancelled(); });
+            }
+
+            std::stringstream input_stream(content);
+            if (config.raw()) {
+                frontend.decode_raw_wav_audio(input_stream, sample_rate_hertz, data_bytes, chunk_size, worker_pool_.get());
+            } else {
+                frontend.decode_wav_audio(input_stream, chunk_size, worker_pool_.get());
+            }
+
+            // decoders eliminated from the race are done, any other interruption
+            // comes from the client
+            for (auto &decoder_ : group_decoders) {
+                if (decoder_->cancelled() && !(race && race->eliminated(decoder_))) cancelled = true;
+            }
+            if (cancelled) return;
+
+            std::vector<utterance_results_t> k_results_;
+            frontend.get_decoded_results(n_best, k_results_, config.word_level(), worker_pool_.get());
+            for (std::size_t k = 0; k < group.size(); k++) {
+                kaldi_serve::ModelResult *result = response->mutable_results(group[k]);
+                if (race && race->eliminated(group_decoders[k])) {
+                    result->set_eliminated(true);
+                    result->set_score(race->score(group_decoders[k]));
+                    continue;
+                }
+                scores[group[k]] = group_decoders[k]->best_path_score();
+                result->set_score(scores[group[k]]);
+                add_alternatives_to_response(k_results_[k], result->mutable_response(), config);
+            }
+        } catch (kaldi::KaldiFatalError &e) {
+            error = std::string(e.what()) + " :: " + std::string(e.KaldiMessage());
+        } catch (std::exception &e) {
+            error = e.what();
+        }
+
+        // a failed group's decoders won't report again, the race goes on without them
+        if (race && !error.empty()) {
+            for (auto &decoder_ : group_decoders) race->withdraw(decoder_);
+        }
+
+        for (auto const &i : group) response->mutable_results(i)->set_error(error);
+    };
+
+    std::vector<std::future<void>> group_futures;
+    for (std::size_t g = 1; g < groups.size(); g++) {
+        group_futures.push_back(std::async(std::launch::async, decode_group, std::cref(groups[g])));
+    }
+    decode_group(groups.front());
+    for (auto &group_future : group_futures) group_future.get();
+
+    // Decoder Release ::
+    // - The frontends already freed the decoders.
+    for (std::size_t i = 0; i < n_models; i++) decoder_queues[i]->release(decoders[i]);
+
+    if (cancelled) return interrupted_status(context);
+
+    // (eliminated and failed models are left at -inf)
+    response->set_winner(std::max_element(scores.begin(), scores.end()) - scores.begin());
+
+    if (DEBUG) {
+        std::chrono::system_clock::time_point end_time = std::chrono::system_clock::now();
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
+        std::cout << "[" << timestamp_now() << "] uuid: " << uuid << " recognized with " << n_models
+                  << " models (" << groups.size() << " frontends) in: " << ms.count() << "ms" << ENDL;
+    }
+
+    return grpc::Status::OK;
+}
+
+grpc::Status KaldiServeImpl::GetStatus(grpc::ServerContext *const context,
+                                       const kaldi_serve::StatusRequest *const request,
+                                       kaldi_serve::StatusResponse *const response) {
+    // answered while draining too, so that balancers see the server going away
+    std::unique_lock<std::mutex> lock(requests_mutex_);
+    response->set_serving(!draining_);
+    response->set_active_requests(n_active_requests_);
+    lock.unlock();
+
+    response->set_resident_memory(resident_memory());
+
+    model_store_->status(response);
+    return grpc::Status::OK;
+}
+
 // Runs the Server with the Kaldi Service
-void run_server(const std::vector<ModelSpec> &model_specs) {
-    KaldiServeImpl service(model_specs);
+// On SIGTERM (or SIGINT) the server drains: the health service reports NOT_SERVING,
+// new requests are refused and the active ones get up to `drain_timeout` to finish
+// before the server shuts down (cancelling whatever is left).
+void run_server(const std::vector<ModelSpec> &model_specs, const ServerSpec &server_spec) {
+    // termination signals are taken by the drain thread alone (blocked in all
+    // the threads started from here on)
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
 
-    std::string server_address("0.0.0.0:5016");
+    KaldiServeImpl service(model_specs, server_spec);
+
+    grpc::EnableDefaultHealthCheckService(true);
+
+    const std::string server_address = server_spec.address;
 
     grpc::ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
     builder.RegisterService(&service);
 
+    // responses are compressed by default when configured (clients may still opt out)
+    if (server_spec.compression == "gzip") {
+        builder.SetDefaultCompressionAlgorithm(GRPC_COMPRESS_GZIP);
+    } else if (server_spec.compression == "deflate") {
+        builder.SetDefaultCompressionAlgorithm(GRPC_COMPRESS_DEFLATE);
+    } else if (!server_spec.compression.empty() && server_spec.compression != "none") {
+        std::cout << ":: Unknown compression " << server_spec.compression << ", responses are not compressed" << ENDL;
+    }
+
     std::unique_ptr<grpc::Server> server(builder.BuildAndStart());
+    server->GetHealthCheckService()->SetServingStatus(true);
+
+    std::thread drain_thread([&]() {
+        int signal;
+        sigwait(&signals, &signal);
+        std::cout << ":: Received " << strsignal(signal) << ", draining" << ENDL;
+
+        server->GetHealthCheckService()->SetServingStatus(false);
+
+        const std::chrono::milliseconds drain_timeout(static_cast<int64>(server_spec.drain_timeout * 1000));
+        if (!service.drain(drain_timeout)) {
+            std::cout << ":: Drain timed out, cancelling the remaining requests" << ENDL;
+        }
+        server->Shutdown(std::chrono::system_clock::now());
+    });
 
     std::cout << "kaldi-serve gRPC Streaming Server listening on " << server_address << ENDL;
     server->Wait();
+    drain_thread.join();
+
+    std::cout << ":: Server stopped" << ENDL;
 }
 
 
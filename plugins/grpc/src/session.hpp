@@ -0,0 +1,153 @@
+// session.hpp - Streaming Session Store
+#pragma once
+
+// stl includes
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// lib includes
+#include <kaldiserve/decoder.hpp>
+
+// local includes
+#include "config.hpp"
+
+using namespace kaldiserve;
+
+
+// SessionStore ::
+// Parks the decoders of interrupted streams (keyed by the request `uuid`)
+// for a short time to live, so that a client reconnecting with the same
+// `uuid` resumes the utterance instead of re-sending (and re-decoding) it.
+// Sessions that are not resumed in time go back to their decoder queue.
+class SessionStore final {
+
+  public:
+    // a non-positive time to live disables parking
+    explicit SessionStore(const std::chrono::milliseconds &ttl);
+
+    SessionStore(const SessionStore &) = delete; // disable copying
+
+    SessionStore &operator=(const SessionStore &) = delete; // disable assignment
+
+    // releases all the parked decoders
+    ~SessionStore();
+
+    inline bool enabled() const noexcept {
+        return ttl_.count() > 0;
+    }
+
+    // parks the decoder of an interrupted stream until resumed or expired
+    // (holding on to the queue keeps the model from being evicted meanwhile)
+    void park(const std::string &uuid, const model_id_t &model_id,
+              Decoder *const decoder, const std::shared_ptr<DecoderQueue> &decoder_queue);
+
+    // takes the parked decoder of the stream for the given model (if any)
+    Decoder *resume(const std::string &uuid, const model_id_t &model_id);
+
+  private:
+    struct Session {
+        model_id_t model_id;
+        Decoder *decoder;
+        std::shared_ptr<DecoderQueue> decoder_queue;
+        std::chrono::steady_clock::time_point expiry;
+    };
+
+    // returns the session's decoder to its queue
+    static void release_(Session &session);
+
+    // reaper thread loop, releases the expired sessions
+    void reap_();
+
+    const std::chrono::milliseconds ttl_;
+
+    std::unordered_map<std::string, Session> sessions_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stop_;
+    std::thread reaper_;
+};
+
+SessionStore::SessionStore(const std::chrono::milliseconds &ttl) : ttl_(ttl), stop_(false) {
+    if (enabled()) reaper_ = std::thread(&SessionStore::reap_, this);
+}
+
+SessionStore::~SessionStore() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    lock.unlock();
+    cond_.notify_all();
+
+    if (reaper_.joinable()) reaper_.join();
+
+    for (auto &entry : sessions_) {
+        release_(entry.second);
+    }
+}
+
+void SessionStore::park(const std::string &uuid, const model_id_t &model_id,
+                        Decoder *const decoder, const std::shared_ptr<DecoderQueue> &decoder_queue) {
+    // the interrupted request's deadline and cancel check go with it
+    decoder->clear_interruption();
+
+    Session session = {model_id, decoder, decoder_queue, std::chrono::steady_clock::now() + ttl_};
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = sessions_.find(uuid);
+    if (it != sessions_.end()) {
+        // a stale session of the same stream is superseded
+        release_(it->second);
+        it->second = session;
+    } else {
+        sessions_.emplace(uuid, session);
+    }
+    lock.unlock();
+    cond_.notify_all();
+}
+
+Decoder *SessionStore::resume(const std::string &uuid, const model_id_t &model_id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto it = sessions_.find(uuid);
+    if (it == sessions_.end()) return nullptr;
+
+    Session session = it->second;
+    sessions_.erase(it);
+    lock.unlock();
+
+    // a different model means a different utterance, start afresh
+    if (session.model_id != model_id) {
+        release_(session);
+        return nullptr;
+    }
+    return session.decoder;
+}
+
+void SessionStore::release_(Session &session) {
+    session.decoder->free_decoder();
+    session.decoder_queue->release(session.decoder);
+}
+
+void SessionStore::reap_() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+        auto now = std::chrono::steady_clock::now();
+        auto next_expiry = now + ttl_;
+
+        for (auto it = sessions_.begin(); it != sessions_.end();) {
+            if (it->second.expiry <= now) {
+                if (DEBUG) std::cout << "[" << timestamp_now() << "] uuid: " << it->first << " session expired" << ENDL;
+                release_(it->second);
+                it = sessions_.erase(it);
+            } else {
+                next_expiry = std::min(next_expiry, it->second.expiry);
+                it++;
+            }
+        }
+        cond_.wait_until(lock, next_expiry);
+    }
+}
\ No newline at end of file
@@ -14,6 +14,7 @@
 // kaldiserve includes
 #include "kaldiserve/model.hpp"
 #include "kaldiserve/decoder.hpp"
+#include "kaldiserve/feature.hpp"
 #include "kaldiserve/types.hpp"
 
 
@@ -23,17 +24,41 @@ void pybind_decoder(py::module &m) {
     // kaldiserve.Decoder
     py::class_<Decoder>(m, "Decoder", "Decoder class.")
         .def(py::init<ChainModel *const>())
-        .def("start_decoding", &Decoder::start_decoding)
+        .def("start_decoding", static_cast<void (Decoder::*)(const std::string &)>(&Decoder::start_decoding))
         .def("free_decoder", &Decoder::free_decoder)
+        .def("cancel", &Decoder::cancel)
+        .def("cancelled", &Decoder::cancelled)
+        .def("clear_interruption", &Decoder::clear_interruption)
+        .def("processed_bytes", &Decoder::processed_bytes)
+        .def("audio_secs", &Decoder::audio_secs)
+        .def("decoding_secs", &Decoder::decoding_secs)
+        .def("best_path_score", &Decoder::best_path_score)
+        // utterance replay journal snapshot -> bytes
+        .def("snapshot", [](Decoder &self) {
+            std::ostringstream snapshot_stream;
+            {
+                py::gil_scoped_release release;
+                self.snapshot(snapshot_stream);
+            }
+            return py::bytes(snapshot_stream.str());
+        })
+        // continue the utterance of a snapshot
+        .def("restore", [](Decoder &self, py::bytes &snapshot_bytes) {
+            std::string snapshot_str(snapshot_bytes);
+            {
+                py::gil_scoped_release release;
+                std::istringstream snapshot_stream(snapshot_str);
+                self.restore(snapshot_stream);
+            }
+        })
         // wav stream chunk
         .def("decode_stream_wav_chunk", [](Decoder &self, py::bytes &wav_bytes) {
             std::string wav_bytes_str(wav_bytes);
             {
                 py::gil_scoped_release release;
-                std::istringstream wav_stream(wav_bytes_str);
-                self.decode_stream_wav_chunk(wav_stream);
+                self.decode_stream_wav_chunk(wav_bytes_str.data(), wav_bytes_str.size());
             }
-            
+
         })
         // raw wav stream chunk
         .def("decode_stream_raw_wav_chunk", [](Decoder &self, py::bytes &wav_bytes,
@@ -67,28 +92,89 @@ void pybind_decoder(py::module &m) {
            py::arg("data_bytes"), py::arg("chunk_size") = 1.0)
         // get decoding results -> list[Alternative]
         .def("get_decoded_results", [](Decoder &self, const int &n_best,
-                                       const bool &word_level, const bool &bidi_streaming) {
+                                       const bool &word_level, const bool &bidi_streaming,
+                                       const bool &stable_words) {
             std::vector<Alternative> alts;
             {
                 py::gil_scoped_release release;
-                self.get_decoded_results(n_best, alts, word_level, bidi_streaming);
+                self.get_decoded_results(n_best, alts, word_level, bidi_streaming, stable_words);
             }
             py::list py_alts = py::cast(alts);
             return py_alts;
         }, py::arg("n_best"),
            py::arg("word_level") = false,
-           py::arg("bidi_streaming") = false);
+           py::arg("bidi_streaming") = false,
+           py::arg("stable_words") = false);
 
     // kaldiserve.DecoderFactory
     py::class_<DecoderFactory>(m, "DecoderFactory", "Decoder Factory class.")
         .def(py::init<const ModelSpec &>())
-        .def("produce", &DecoderFactory::produce, py::call_guard<py::gil_scoped_release>(), py::return_value_policy::reference);
+        .def("produce", &DecoderFactory::produce, py::arg("replica") = 0, py::call_guard<py::gil_scoped_release>(), py::return_value_policy::reference)
+        .def("n_replicas", &DecoderFactory::n_replicas);
 
     // kaldiserve.DecoderQueue
     py::class_<DecoderQueue>(m, "DecoderQueue", "Decoder Queue class.")
         .def(py::init<const ModelSpec &>())
-        .def("acquire", &DecoderQueue::acquire, py::call_guard<py::gil_scoped_release>(), py::return_value_policy::reference)
-        .def("release", &DecoderQueue::release);//, py::call_guard<py::gil_scoped_release>());
+        .def("acquire", static_cast<Decoder *(DecoderQueue::*)(const Priority &)>(&DecoderQueue::acquire),
+             py::arg("priority") = Priority::REALTIME, py::call_guard<py::gil_scoped_release>(), py::return_value_policy::reference)
+        .def("acquire_many", [](DecoderQueue &self, const std::size_t &n, const Priority &priority) {
+            std::vector<Decoder*> decoders;
+            {
+                py::gil_scoped_release release;
+                self.acquire(n, decoders, priority);
+            }
+            return decoders;
+        }, py::arg("n"), py::arg("priority") = Priority::REALTIME, py::return_value_policy::reference)
+        .def("release", &DecoderQueue::release)//, py::call_guard<py::gil_scoped_release>());
+        .def("chunk_size", &DecoderQueue::chunk_size)
+        .def("status", &DecoderQueue::status);
+
+    // kaldiserve.SharedFrontend
+    py::class_<SharedFrontend>(m, "SharedFrontend", "Feature frontend shared by decoders of a feature group.")
+        .def(py::init<const std::vector<Decoder*> &, const std::string &>(),
+             py::arg("decoders"), py::arg("uuid") = "", py::keep_alive<1, 2>())
+        // wav audio
+        .def("decode_wav_audio", [](SharedFrontend &self, py::bytes &wav_bytes, const float &chunk_size) {
+            std::string wav_bytes_str(wav_bytes);
+            {
+                py::gil_scoped_release release;
+                std::istringstream wav_stream(wav_bytes_str);
+                self.decode_wav_audio(wav_stream, chunk_size);
+            }
+        }, py::arg("wav_bytes"), py::arg("chunk_size") = 1.0)
+        .def("set_race", &SharedFrontend::set_race, py::keep_alive<1, 2>())
+        // raw wav audio
+        .def("decode_raw_wav_audio", [](SharedFrontend &self, py::bytes &wav_bytes, const float &samp_freq,
+                                        const int &data_bytes, const float &chunk_size) {
+            std::string wav_bytes_str(wav_bytes);
+            {
+                py::gil_scoped_release release;
+                std::istringstream wav_stream(wav_bytes_str);
+                self.decode_raw_wav_audio(wav_stream, samp_freq, data_bytes, chunk_size);
+            }
+        }, py::arg("wav_bytes"), py::arg("samp_freq"),
+           py::arg("data_bytes"), py::arg("chunk_size") = 1.0)
+        // get decoding results -> list[list[Alternative]] (one per decoder)
+        .def("get_decoded_results", [](SharedFrontend &self, const int &n_best, const bool &word_level) {
+            std::vector<utterance_results_t> results;
+            {
+                py::gil_scoped_release release;
+                self.get_decoded_results(n_best, results, word_level);
+            }
+            py::list py_results;
+            for (auto const &alts : results) py_results.append(py::cast(alts));
+            return py_results;
+        }, py::arg("n_best"), py::arg("word_level") = false);
+
+    // kaldiserve.DecoderRace
+    py::class_<DecoderRace>(m, "DecoderRace", "Early winner selection among decoders of the same audio.")
+        .def(py::init<const std::vector<Decoder*> &, const float &, const float &, const float &>(),
+             py::arg("decoders"), py::arg("margin") = 1.0, py::arg("min_secs") = 1.0, py::arg("interval") = 0.5,
+             py::keep_alive<1, 2>())
+        .def("report", &DecoderRace::report, py::call_guard<py::gil_scoped_release>())
+        .def("withdraw", &DecoderRace::withdraw)
+        .def("eliminated", &DecoderRace::eliminated)
+        .def("score", &DecoderRace::score);
 }
 
 } // namespace kaldiserve
\ No newline at end of file
@@ -15,6 +15,28 @@ void pybind_types(py::module &m) {
 
     py::bind_vector<std::vector<ModelSpec>>(m, "_ModelSpecList");
 
+    // kaldiserve.Priority
+    py::enum_<Priority>(m, "Priority", "Decoding priority class.")
+        .value("REALTIME", Priority::REALTIME)
+        .value("BATCH", Priority::BATCH)
+        .export_values();
+
+    // kaldiserve.QueueStatus
+    py::class_<QueueStatus>(m, "QueueStatus", "Decoder Queue load struct.")
+        .def(py::init<>())
+        .def_readonly("n_decoders", &QueueStatus::n_decoders)
+        .def_readonly("n_free", &QueueStatus::n_free)
+        .def_readonly("n_waiting", &QueueStatus::n_waiting)
+        .def_readonly("wait_estimate", &QueueStatus::wait_estimate)
+        .def_readonly("rtf", &QueueStatus::rtf)
+        .def("__repr__", [](const QueueStatus &qs) {
+            return "<kaldiserve.QueueStatus {n_decoders: " + std::to_string(qs.n_decoders) +
+                   ", n_free: " + std::to_string(qs.n_free) +
+                   ", n_waiting: " + std::to_string(qs.n_waiting) +
+                   ", wait_estimate: " + std::to_string(qs.wait_estimate) +
+                   ", rtf: " + std::to_string(qs.rtf) + "}>";
+        });
+
     // kaldiserve.ModelSpec
     py::class_<ModelSpec>(m, "ModelSpec", "Model Specification struct.")
         .def(py::init<>())
@@ -25,14 +47,26 @@ void pybind_types(py::module &m) {
         .def_readonly("min_active", &ModelSpec::min_active)
         .def_readonly("max_active", &ModelSpec::max_active)
         .def_readonly("frame_subsampling_factor", &ModelSpec::frame_subsampling_factor)
+        .def_readonly("frames_per_chunk", &ModelSpec::frames_per_chunk)
         .def_readonly("beam", &ModelSpec::beam)
         .def_readonly("lattice_beam", &ModelSpec::lattice_beam)
         .def_readonly("acoustic_scale", &ModelSpec::acoustic_scale)
         .def_readonly("silence_weight", &ModelSpec::silence_weight)
+        .def_readonly("feature_type", &ModelSpec::feature_type)
+        .def_readonly("use_ivectors", &ModelSpec::use_ivectors)
+        .def_readonly("add_pitch", &ModelSpec::add_pitch)
+        .def_readonly("feature_group", &ModelSpec::feature_group)
         .def_readonly("max_ngram_order", &ModelSpec::max_ngram_order)
         .def_readonly("rnnlm_weight", &ModelSpec::rnnlm_weight)
         .def_readonly("bos_index", &ModelSpec::bos_index)
         .def_readonly("eos_index", &ModelSpec::eos_index)
+        .def_readonly("chunk_size", &ModelSpec::chunk_size)
+        .def_readonly("auto_chunk_size", &ModelSpec::auto_chunk_size)
+        .def_readonly("silence_weighting_period", &ModelSpec::silence_weighting_period)
+        .def_readonly("advance_frames", &ModelSpec::advance_frames)
+        .def_readonly("enable_snapshots", &ModelSpec::enable_snapshots)
+        .def_readonly("quantum_frames", &ModelSpec::quantum_frames)
+        .def_readonly("numa_replicate", &ModelSpec::numa_replicate)
         .def("__repr__", [](const ModelSpec &ms) {
             return "<kaldiserve.ModelSpec {name: '" + ms.name +
                    "', language_code: '" + ms.language_code +
@@ -77,6 +111,7 @@ void pybind_types(py::module &m) {
         .def_readonly("am_score", &Alternative::am_score)
         .def_readonly("lm_score", &Alternative::lm_score)
         .def_readonly("words", &Alternative::words)
+        .def_readonly("stable_words", &Alternative::stable_words)
         .def("__repr__", [](const Alternative &alt) {
             return "<kaldiserve.Alternative {transcript: '" + alt.transcript +
                     "', confidence: '" + std::to_string(alt.confidence) +
@@ -22,6 +22,8 @@ void pybind_utils(py::module &m) {
         py::list py_model_specs = py::cast(model_specs);
         return py_model_specs;
     });
+
+    m.def("resident_memory", &resident_memory);
 }
 
 } // namespace kaldiserve
\ No newline at end of file
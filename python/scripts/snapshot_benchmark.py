@@ -0,0 +1,90 @@
+"""
+Decoder snapshot benchmark using kaldiserve.
+
+Streams an audio file in chunks and snapshots the decoder every few seconds,
+restoring each snapshot on a second decoder. Snapshots are replay journals of
+the utterance, so their sizes and restore times grow with the audio decoded so
+far. Reports snapshot sizes, snapshot and restore times, and whether the restored decoder ends up with the same
+transcript. Needs `enable_snapshots = true` in the model spec.
+
+Usage: snapshot_benchmark.py [options] <model-spec-toml> <audio-path>
+
+Options:
+    --chunk-size=<secs>     Size of the streamed chunks [default: 0.2]
+    --interval=<secs>       Audio between two snapshots [default: 5.0]
+"""
+import time
+import wave
+
+from docopt import docopt
+
+import kaldiserve as ks
+
+
+def transcript(decoder: ks.Decoder) -> str:
+    alts = decoder.get_decoded_results(1, False, False)
+    return alts[0].transcript if alts else ""
+
+
+if __name__ == "__main__":
+    args = docopt(__doc__)
+
+    model_spec_toml = args["<model-spec-toml>"]
+    audio_path = args["<audio-path>"]
+    chunk_size = float(args["--chunk-size"])
+    interval = float(args["--interval"])
+
+    # parse model spec
+    model_spec = ks.parse_model_specs(model_spec_toml)[0]
+    if not model_spec.enable_snapshots:
+        raise SystemExit("enable_snapshots is not set for the model")
+
+    # create decoder queue
+    decoder_queue = ks.DecoderQueue(model_spec)
+
+    # read raw audio samples
+    with wave.open(audio_path, "rb") as f:
+        samp_freq = f.getframerate()
+        if f.getnchannels() != 1 or f.getsampwidth() != 2:
+            raise SystemExit("expected 16-bit mono audio")
+        audio_bytes = f.readframes(f.getnframes())
+
+    chunk_bytes = int(chunk_size * samp_freq) * 2
+    interval_bytes = int(interval * samp_freq) * 2
+
+    with ks.acquire_decoders(decoder_queue, 2) as (decoder, restored):
+        with ks.start_decoding(decoder, "snapshot-benchmark"):
+            snapshot = None
+            for offset in range(0, len(audio_bytes), chunk_bytes):
+                chunk = audio_bytes[offset:offset + chunk_bytes]
+                decoder.decode_stream_raw_wav_chunk(chunk, samp_freq, len(chunk))
+
+                if (offset + len(chunk)) // interval_bytes == offset // interval_bytes:
+                    continue
+
+                start = time.time()
+                snapshot = decoder.snapshot()
+                snapshot_time = time.time() - start
+
+                start = time.time()
+                restored.restore(snapshot)
+                restore_time = time.time() - start
+
+                audio_secs = (offset + len(chunk)) / (2 * samp_freq)
+                print(f"{audio_secs:8.2f}s audio: snapshot {len(snapshot) / 1024:8.1f}KiB "
+                      f"in {snapshot_time * 1000:7.2f}ms, restored in {restore_time * 1000:8.2f}ms")
+
+            # the restored decoder continues with the audio after its snapshot
+            if snapshot is not None:
+                restored.restore(snapshot)
+                for offset in range(restored.processed_bytes(), len(audio_bytes), chunk_bytes):
+                    chunk = audio_bytes[offset:offset + chunk_bytes]
+                    restored.decode_stream_raw_wav_chunk(chunk, samp_freq, len(chunk))
+
+                original_transcript = transcript(decoder)
+                restored_transcript = transcript(restored)
+                restored.free_decoder()
+
+                print(f"original: {original_transcript}")
+                print(f"restored: {restored_transcript}")
+                print(f"transcripts match: {original_transcript == restored_transcript}")
\ No newline at end of file
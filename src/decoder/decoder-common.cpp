@@ -53,17 +53,17 @@ void find_alternatives(kaldi::CompactLattice &clat,
             // Something went wrong.  A warning will already have been printed.
             KALDI_WARN << "Empty lattice after RNNLM rescoring.";
         } else {
-            clat = composed_clat;
+            clat = std::move(composed_clat);
         }
     }
 
-    auto lat = make_uniq<kaldi::Lattice>();
-    fst::ConvertLattice(clat, lat.get());
+    kaldi::Lattice lat;
+    fst::ConvertLattice(clat, &lat);
 
     kaldi::Lattice nbest_lat;
     std::vector<kaldi::Lattice> nbest_lats;
 
-    fst::ShortestPath(*lat, &nbest_lat, n_best);
+    fst::ShortestPath(lat, &nbest_lat, n_best);
     fst::ConvertNbestToVector(nbest_lat, &nbest_lats);
 
     if (nbest_lats.empty()) {
@@ -71,28 +71,25 @@ void find_alternatives(kaldi::CompactLattice &clat,
         return;
     }
 
+    results.reserve(results.size() + nbest_lats.size());
     for (auto const &l : nbest_lats) {
         // NOTE: Check why int32s specifically are used here
         std::vector<int32> input_ids;
         std::vector<int32> word_ids;
-        std::vector<std::string> word_strings;
-        std::string sentence;
 
         kaldi::LatticeWeight weight;
         fst::GetLinearSymbolSequence(l, &input_ids, &word_ids, &weight);
 
+        results.emplace_back();
+        Alternative &alt = results.back();
+        // the transcript is built in place, without a vector of word strings
         for (auto const &wid : word_ids) {
-            word_strings.push_back(model->word_syms->Find(wid));
+            if (!alt.transcript.empty()) alt.transcript += ' ';
+            alt.transcript += model->word_syms->Find(wid);
         }
-        string_join(word_strings, " ", sentence);
-
-        Alternative alt;
-        alt.transcript = sentence;
         alt.lm_score = float(weight.Value1());
         alt.am_score = float(weight.Value2());
         alt.confidence = calculate_confidence(alt.lm_score, alt.am_score, word_ids.size());
-
-        results.push_back(alt);
     }
 
     if (!(options.enable_word_level && word_level))
@@ -1,16 +1,54 @@
 // decoder-factory.cpp - Decoder Factory Implementation
 
+// stl includes
+#include <exception>
+#include <thread>
+
 // local includes
 #include "config.hpp"
 #include "types.hpp"
 #include "model.hpp"
 #include "decoder.hpp"
+#include "utils.hpp"
 
 
 namespace kaldiserve {
 
 DecoderFactory::DecoderFactory(const ModelSpec &model_spec) : model_spec(model_spec) {
-    model_ = make_uniq<ChainModel>(model_spec);
+    const int n_nodes = model_spec.numa_replicate ? numa_node_count() : 1;
+
+    if (n_nodes == 1) {
+        models_.push_back(make_uniq<ChainModel>(model_spec));
+        return;
+    }
+
+    std::cout << ":: Replicating model on " << n_nodes << " NUMA nodes" << ENDL;
+
+    // each replica is loaded by a thread pinned to its node so that the
+    // model memory is first touched (and hence allocated) on that node
+    models_.resize(n_nodes);
+    std::vector<std::exception_ptr> errors(n_nodes);
+    std::vector<std::thread> loaders;
+
+    for (int node = 0; node < n_nodes; node++) {
+        loaders.emplace_back([this, node, &model_spec, &errors]() {
+            try {
+                if (!pin_thread_to_numa_node(node)) {
+                    KALDI_WARN << "Could not pin model loader to NUMA node " << node;
+                }
+                models_[node] = make_uniq<ChainModel>(model_spec);
+                models_[node]->numa_node = node;
+            } catch (...) {
+                errors[node] = std::current_exception();
+            }
+        });
+    }
+
+    for (auto &loader : loaders) loader.join();
+
+    for (auto const &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
 }
 
 } // namespace kaldiserve
\ No newline at end of file
@@ -1,47 +1,249 @@
 // decoder-queue.cpp - Decoder Queue Implementation
 
+// stl includes
+#include <exception>
+#include <future>
+#include <thread>
+
 // local includes
 #include "config.hpp"
 #include "decoder.hpp"
 #include "types.hpp"
+#include "utils.hpp"
+#include "worker.hpp"
 
 
 namespace kaldiserve {
 
+// weight of the latest decoder lease in the moving averages of `status`
+static const double LEASE_AVERAGE_WEIGHT = 0.1;
+
+static inline void update_average(double &average, const double &value) noexcept {
+    average = average > 0 ? (1 - LEASE_AVERAGE_WEIGHT) * average + LEASE_AVERAGE_WEIGHT * value : value;
+}
+
 DecoderQueue::DecoderQueue(const ModelSpec &model_spec) {
     std::cout << ":: Loading model from " << model_spec.path << ENDL;
 
     decoder_factory_ = make_uniq<DecoderFactory>(model_spec);
+    avg_hold_secs_ = 0;
+    avg_rtf_ = 0;
+
+    // decoders are spread evenly over the model replicas
+    n_decoders_ = model_spec.n_decoders;
+    queues_.resize(decoder_factory_->n_replicas());
     for (size_t i = 0; i < model_spec.n_decoders; i++) {
-        queue_.push(decoder_factory_->produce());
+        const std::size_t replica = i % queues_.size();
+        queues_[replica].push(decoder_factory_->produce(replica));
+    }
+
+    chunk_size_ = model_spec.chunk_size;
+    if (model_spec.auto_chunk_size && model_spec.n_decoders > 0) {
+        chunk_size_ = tune_chunk_size_();
+        std::cout << ":: Tuned chunk size for " << model_spec.name << " :: " << chunk_size_ << "s" << ENDL;
     }
 }
 
 DecoderQueue::~DecoderQueue() {
-    while (!queue_.empty()) {
-        auto decoder = queue_.front();
-        queue_.pop();
-        delete decoder;
+    for (auto &queue : queues_) {
+        while (!queue.empty()) {
+            auto decoder = queue.front();
+            queue.pop();
+            delete decoder;
+        }
     }
 }
 
 void DecoderQueue::push_(Decoder *const item) {
+    const std::size_t replica = item->numa_node() < 0 ? 0 : item->numa_node();
+
     std::unique_lock<std::mutex> mlock(mutex_);
-    queue_.push(item);
+    queues_[replica].push(item);
+
+    auto lease = leases_.find(item);
+    if (lease != leases_.end()) {
+        const std::chrono::duration<double> held = std::chrono::steady_clock::now() - lease->second.acquired;
+        update_average(avg_hold_secs_, held.count());
+
+        const double audio_secs = item->audio_secs() - lease->second.audio_secs;
+        if (audio_secs > 0) update_average(avg_rtf_, (item->decoding_secs() - lease->second.decoding_secs) / audio_secs);
+        leases_.erase(lease);
+    }
     mlock.unlock();
-    cond_.notify_one(); // condition var notifies another suspended thread (help up in `pop`)
+    // condition var notifies the suspended threads (held up in `pop`), all of
+    // them are woken up so that the highest priority waiter gets the decoder
+    cond_.notify_all();
 }
 
-Decoder *DecoderQueue::pop_() {
+Decoder *DecoderQueue::pop_(const Priority &priority) {
+    std::vector<Decoder*> items;
+    pop_(1, items, priority);
+    return items.front();
+}
+
+void DecoderQueue::pop_(const std::size_t &n, std::vector<Decoder*> &items, const Priority &priority) {
+    if (n > n_decoders_) {
+        KALDI_ERR << "requested " << n << " decoders, but the queue only has " << n_decoders_;
+    }
+
+    const bool numa_aware = queues_.size() > 1;
+    // prefer decoders whose model replica is local to the calling thread
+    const std::size_t preferred = numa_aware ? current_numa_node() % queues_.size() : 0;
+
+    items.clear();
+    items.reserve(n);
+
     std::unique_lock<std::mutex> mlock(mutex_);
-    // waits until a decoder object is available
-    while (queue_.empty()) {
+    n_waiting_[priority]++;
+    // waits until `n` decoder objects are available (on any replicas) and
+    // no thread of a higher priority class is waiting for one
+    while (items.empty()) {
+        bool preceded = false;
+        for (int p = REALTIME; p < priority; p++) {
+            if (n_waiting_[p] > 0) preceded = true;
+        }
+
+        std::size_t n_free = 0;
+        for (auto const &queue : queues_) {
+            n_free += queue.size();
+        }
+
+        if (!preceded && n_free >= n) {
+            for (std::size_t i = 0; i < queues_.size() && items.size() < n; i++) {
+                auto &queue = queues_[(preferred + i) % queues_.size()];
+                while (!queue.empty() && items.size() < n) {
+                    items.push_back(queue.front());
+                    queue.pop();
+                }
+            }
+        }
         // suspends current thread execution and awaits condition notification
-        cond_.wait(mlock);
+        if (items.empty()) cond_.wait(mlock);
+    }
+    n_waiting_[priority]--;
+
+    const auto now = std::chrono::steady_clock::now();
+    for (auto const &item : items) {
+        leases_[item] = Lease{now, item->audio_secs(), item->decoding_secs()};
     }
-    auto item = queue_.front();
-    queue_.pop();
-    return item;
+    mlock.unlock();
+    // lower priority waiters held back by this thread may proceed now
+    // (the decoding itself is kept on the model's node by the worker pool)
+    cond_.notify_all();
+}
+
+void DecoderQueue::decode_batch(const std::size_t &n_items,
+                                const std::function<void(const std::size_t &, Decoder *const)> &decode,
+                                WorkerPool *const worker_pool,
+                                const Priority &priority) {
+    if (n_items == 0) return;
+    // (waiting for decoders of an empty queue would never return)
+    if (n_decoders_ == 0) KALDI_ERR << "can't decode a batch, the queue has no decoders";
+
+    // one lane per decoder, each working through the items one after another
+    std::size_t n_lanes = worker_pool != nullptr && worker_pool->size() > 0
+                              ? worker_pool->size()
+                              : std::max(1u, std::thread::hardware_concurrency());
+    n_lanes = std::min(std::min(n_lanes, n_items), n_decoders_);
+
+    // the decoders are taken up front, on the calling thread, so that pool
+    // workers never block waiting for one
+    std::vector<Decoder*> decoders;
+    pop_(n_lanes, decoders, priority);
+
+    std::atomic<std::size_t> next_item(0);
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+    auto run_lane = [&](Decoder *const decoder) {
+        for (std::size_t i = next_item++; i < n_items; i = next_item++) {
+            try {
+                decode(i, decoder);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) error = std::current_exception();
+            }
+            decoder->free_decoder();
+        }
+    };
+
+    std::vector<std::future<void>> lanes;
+    lanes.reserve(n_lanes);
+    for (auto const &decoder : decoders) {
+        auto lane = std::bind(run_lane, decoder);
+        if (worker_pool != nullptr && worker_pool->size() > 0) {
+            lanes.push_back(worker_pool->submit(lane, decoder->numa_node(), priority));
+        } else {
+            lanes.push_back(std::async(std::launch::async, lane));
+        }
+    }
+
+    for (auto &lane : lanes) lane.wait();
+
+    for (auto const &decoder : decoders) push_(decoder);
+
+    if (error) std::rethrow_exception(error);
+}
+
+QueueStatus DecoderQueue::status() const {
+    QueueStatus status;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    status.n_decoders = n_decoders_;
+    for (auto const &queue : queues_) {
+        status.n_free += queue.size();
+    }
+    for (int p = 0; p < N_PRIORITIES; p++) {
+        status.n_waiting += n_waiting_[p];
+    }
+
+    // a new request waits for the decoders to free up for everyone queued
+    // ahead of it, the decoders being released at the average hold rate
+    if (status.n_waiting >= status.n_free && n_decoders_ > 0) {
+        status.wait_estimate = (status.n_waiting - status.n_free + 1) * avg_hold_secs_ / n_decoders_;
+    }
+    status.rtf = avg_rtf_;
+
+    return status;
+}
+
+float DecoderQueue::tune_chunk_size_() {
+    const float candidates[] = {0.25, 0.5, 1.0, 2.0, 4.0, 8.0};
+
+    Decoder *decoder = pop_(BATCH);
+    const float samp_freq = decoder->samp_freq();
+
+    // low level noise keeps the search busy without depending on test audio
+    kaldi::Vector<kaldi::BaseFloat> audio(int32(8 * samp_freq));
+    for (int32 i = 0; i < audio.Dim(); i++) {
+        audio(i) = 100 * kaldi::RandGauss();
+    }
+
+    float best_chunk_size = candidates[0];
+    double best_time = std::numeric_limits<double>::max();
+
+    // the first pass also warms up the decoder (allocations, caches)
+    for (int pass = 0; pass < 2; pass++) {
+        for (auto const &chunk_size : candidates) {
+            utterance_results_t results;
+            const auto start = std::chrono::steady_clock::now();
+
+            decoder->start_decoding("warmup");
+            decoder->decode_audio(audio, samp_freq, chunk_size);
+            decoder->get_decoded_results(1, results);
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            if (pass > 0 && elapsed.count() < best_time) {
+                best_time = elapsed.count();
+                best_chunk_size = chunk_size;
+            }
+        }
+    }
+
+    decoder->free_decoder();
+    push_(decoder);
+
+    return best_chunk_size;
 }
 
 } // namespace kaldiserve
\ No newline at end of file
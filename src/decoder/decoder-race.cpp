@@ -0,0 +1,104 @@
+// decoder-race.cpp - Decoder Race Implementation
+
+// stl includes
+#include <algorithm>
+#include <limits>
+
+// local includes
+#include "config.hpp"
+#include "decoder.hpp"
+#include "types.hpp"
+
+
+namespace kaldiserve {
+
+DecoderRace::DecoderRace(const std::vector<Decoder*> &decoders,
+                         const float &margin,
+                         const float &min_secs,
+                         const float &interval)
+    : margin_(margin), min_secs_(min_secs), interval_(interval), n_checked_(0) {
+    for (auto const &decoder : decoders) entries_.push_back({decoder, false, false, {}});
+}
+
+void DecoderRace::report(Decoder *const decoder, const double &audio_secs) {
+    std::size_t n_reached = 0;
+    if (audio_secs >= min_secs_) {
+        n_reached = interval_ > 0 ? 1 + std::size_t((audio_secs - min_secs_) / interval_) : 1;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    Entry &entry = entry_(decoder);
+    if (entry.eliminated || entry.withdrawn || n_reached <= entry.scores.size()) return;
+    lock.unlock();
+
+    // the traceback is taken without holding up the other decoders' reports
+    const kaldi::BaseFloat score = decoder->best_path_score();
+
+    lock.lock();
+    // a chunk spanning several checkpoints scores the same at all of them
+    if (!entry.withdrawn) entry.scores.resize(n_reached, score);
+
+    advance_();
+}
+
+void DecoderRace::withdraw(Decoder *const decoder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Entry &entry = entry_(decoder);
+    if (entry.eliminated || entry.withdrawn) return;
+
+    entry.withdrawn = true;
+    advance_();
+}
+
+bool DecoderRace::eliminated(Decoder *const decoder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entry_(decoder).eliminated;
+}
+
+kaldi::BaseFloat DecoderRace::score(Decoder *const decoder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const Entry &entry = entry_(decoder);
+    return entry.scores.empty() ? -std::numeric_limits<kaldi::BaseFloat>::infinity() : entry.scores.back();
+}
+
+DecoderRace::Entry &DecoderRace::entry_(Decoder *const decoder) {
+    auto it = std::find_if(entries_.begin(), entries_.end(), [decoder](const Entry &entry) {
+        return entry.decoder == decoder;
+    });
+    if (it == entries_.end()) KALDI_ERR << "decoder is not in the race";
+    return *it;
+}
+
+void DecoderRace::advance_() {
+    while (true) {
+        // (with every racer out, there is nothing left to compare)
+        std::size_t n_racing = 0;
+        bool reached = true;
+        for (auto const &entry : entries_) {
+            if (entry.eliminated || entry.withdrawn) continue;
+            n_racing++;
+            if (entry.scores.size() <= n_checked_) reached = false;
+        }
+        if (n_racing == 0 || !reached) break;
+
+        check_(n_checked_);
+        n_checked_++;
+    }
+}
+
+void DecoderRace::check_(const std::size_t &checkpoint) {
+    kaldi::BaseFloat leader_score = -std::numeric_limits<kaldi::BaseFloat>::infinity();
+    for (auto const &entry : entries_) {
+        if (!entry.eliminated && !entry.withdrawn) leader_score = std::max(leader_score, entry.scores[checkpoint]);
+    }
+
+    // the leader itself never trails, so one decoder always stays in the race
+    for (auto &entry : entries_) {
+        if (!entry.eliminated && !entry.withdrawn && entry.scores[checkpoint] < leader_score - margin_) {
+            entry.eliminated = true;
+            entry.decoder->cancel();
+        }
+    }
+}
+
+} // namespace kaldiserve
\ No newline at end of file
@@ -3,7 +3,9 @@
 // local includes
 #include "config.hpp"
 #include "decoder.hpp"
+#include "feature.hpp"
 #include "types.hpp"
+#include "worker.hpp"
 
 
 namespace kaldiserve {
@@ -14,27 +16,48 @@ Decoder::Decoder(ChainModel *const model) : model_(model) {
     if (model_->rnnlm_info != nullptr) options.enable_rnnlm = true;
 
     // decoder vars initialization
-    decoder_ = NULL;
+    decoder_ = new kaldi::LatticeFasterOnlineDecoder(*model_->decode_fst, model_->lattice_faster_decoder_config);
+
+    decodable_ = NULL;
     feature_pipeline_ = NULL;
     silence_weighting_ = NULL;
     adaptation_state_ = NULL;
+
+    // the looped nnet outputs frames in whole chunks, so the search is
+    // advanced in multiples of the chunk (in output frames)
+    const int32 chunk_frames = model_->decodable_info->frames_per_chunk / model_->decodable_opts.frame_subsampling_factor;
+    const int32 min_frames = std::max(model_->model_spec.advance_frames, 1);
+    advance_frames_ = ((min_frames + chunk_frames - 1) / chunk_frames) * chunk_frames;
+    samples_since_weighting_ = 0;
+    processed_bytes_ = 0;
+    history_samp_freq_ = 0;
+    audio_secs_ = 0;
+    decoding_secs_ = 0;
+
+    cancelled_ = false;
+    deadline_ = std::chrono::system_clock::time_point::max();
 }
 
 Decoder::~Decoder() noexcept {
     free_decoder();
+    delete decoder_;
 }
 
 void Decoder::start_decoding(const std::string &uuid) noexcept {
     free_decoder();
 
-    adaptation_state_ = new kaldi::OnlineIvectorExtractorAdaptationState(model_->feature_info->ivector_extractor_info);
-
     feature_pipeline_ = new kaldi::OnlineNnet2FeaturePipeline(*model_->feature_info);
-    feature_pipeline_->SetAdaptationState(*adaptation_state_);
 
-    decoder_ = new kaldi::SingleUtteranceNnet3Decoder(model_->lattice_faster_decoder_config,
-                                                      model_->trans_model, *model_->decodable_info,
-                                                      *model_->decode_fst, feature_pipeline_);
+    if (model_->feature_info->use_ivectors) {
+        adaptation_state_ = new kaldi::OnlineIvectorExtractorAdaptationState(model_->feature_info->ivector_extractor_info);
+        feature_pipeline_->SetAdaptationState(*adaptation_state_);
+    }
+
+    // the looped computation is compiled once per model (`decodable_info`),
+    // only the nnet computer state is created per utterance
+    decodable_ = new kaldi::nnet3::DecodableAmNnetLoopedOnline(model_->trans_model, *model_->decodable_info,
+                                                              feature_pipeline_->InputFeature(),
+                                                              feature_pipeline_->IvectorFeature());
     decoder_->InitDecoding();
 
     silence_weighting_ = new kaldi::OnlineSilenceWeighting(model_->trans_model,
@@ -44,10 +67,35 @@ void Decoder::start_decoding(const std::string &uuid) noexcept {
     uuid_ = uuid;
 }
 
+void Decoder::start_decoding(const std::string &uuid, SharedFrontend *const frontend) {
+    free_decoder();
+
+    // only the search state is per decoder, features (and i-vectors) are read
+    // from the frontend and the audio goes to it
+    decodable_ = new kaldi::nnet3::DecodableAmNnetLoopedOnline(model_->trans_model, *model_->decodable_info,
+                                                              frontend->input_feature(),
+                                                              frontend->ivector_feature());
+    decoder_->InitDecoding();
+
+    uuid_ = uuid;
+}
+
+void Decoder::decode_shared_chunk(const kaldi::BaseFloat &chunk_secs) {
+    const auto start = std::chrono::steady_clock::now();
+
+    if (decodable_->NumFramesReady() - decoder_->NumFramesDecoded() >= advance_frames_) {
+        _advance_decoding();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    decoding_secs_ += elapsed.count();
+    audio_secs_ += chunk_secs;
+}
+
 void Decoder::free_decoder() noexcept {
-    if (decoder_) {
-        delete decoder_;
-        decoder_ = NULL;
+    if (decodable_) {
+        delete decodable_;
+        decodable_ = NULL;
     }
     if (adaptation_state_) {
         delete adaptation_state_;
@@ -61,34 +109,56 @@ void Decoder::free_decoder() noexcept {
         delete silence_weighting_;
         silence_weighting_ = NULL;
     }
+    wav_bytes_.clear();
+    wav_samples_.clear();
+    delta_weights_.clear();
+    wav_parser_.reset();
+    samples_since_weighting_ = 0;
+    processed_bytes_ = 0;
+    pcm_history_.clear();
+    float_history_.clear();
+    chunk_history_.clear();
+    history_samp_freq_ = 0;
     uuid_ = "";
+    cancelled_ = false;
+    deadline_ = std::chrono::system_clock::time_point::max();
+    cancel_check_ = nullptr;
 }
 
 void Decoder::decode_stream_wav_chunk(std::istream &wav_stream) {
-    kaldi::WaveData wave_data;
-    wave_data.Read(wav_stream);
+    wav_bytes_.assign(std::istreambuf_iterator<char>(wav_stream), std::istreambuf_iterator<char>());
+    decode_stream_wav_chunk(wav_bytes_.data(), wav_bytes_.size());
+    wav_bytes_.clear();
+}
 
-    const kaldi::BaseFloat samp_freq = wave_data.SampFreq();
+void Decoder::decode_stream_wav_chunk(const char *data, const std::size_t &size) {
+    // an interrupted utterance takes in no more audio
+    if (cancelled()) return;
+    processed_bytes_ += size;
 
     // get the data for channel zero (if the signal is not mono, we only
     // take the first channel).
-    kaldi::SubVector<kaldi::BaseFloat> wave_part(wave_data.Data(), 0);
-    std::vector<std::pair<int32, kaldi::BaseFloat>> delta_weights;
-    _decode_wave(wave_part, delta_weights, samp_freq);
+    wav_parser_.parse(data, size, wav_samples_);
+    if (wav_samples_.empty()) return;
+
+    kaldi::SubVector<kaldi::BaseFloat> wave_part(wav_samples_.data(), wav_samples_.size());
+    _decode_wave(wave_part, delta_weights_, wav_parser_.samp_freq(), wav_parser_.sample_format() == PCM_16);
 }
 
 void Decoder::decode_stream_raw_wav_chunk(std::istream &wav_stream,
                                           const float& samp_freq,
                                           const int &data_bytes) {
-    kaldi::Matrix<kaldi::BaseFloat> wave_matrix;    
-    read_raw_wav_stream(wav_stream, data_bytes, wave_matrix);
+    // an interrupted utterance takes in no more audio
+    if (cancelled()) return;
 
-    // get the data for channel zero (if the signal is not mono, we only
-    // take the first channel).
-    kaldi::SubVector<kaldi::BaseFloat> wave_part(wave_matrix, 0);
-    std::vector<std::pair<int32, kaldi::BaseFloat>> delta_weights;
+    // an odd trailing byte (split sample) stays buffered for the next chunk
+    read_raw_wav_stream(wav_stream, data_bytes, wav_bytes_, wav_samples_);
+    // (the bytes actually read, a chunk may fall short of `data_bytes`)
+    processed_bytes_ += wav_stream.gcount();
 
-    _decode_wave(wave_part, delta_weights, samp_freq);
+    // raw audio is read as mono, so the whole buffer is channel zero.
+    kaldi::SubVector<kaldi::BaseFloat> wave_part(wav_samples_.data(), wav_samples_.size());
+    _decode_wave(wave_part, delta_weights_, samp_freq, true);
 }
 
 void Decoder::decode_wav_audio(std::istream &wav_stream,
@@ -99,42 +169,24 @@ void Decoder::decode_wav_audio(std::istream &wav_stream,
     // get the data for channel zero (if the signal is not mono, we only
     // take the first channel).
     kaldi::SubVector<kaldi::BaseFloat> data(wave_data.Data(), 0);
-    const kaldi::BaseFloat samp_freq = wave_data.SampFreq();
-
-    int32 chunk_length;
-    if (chunk_size > 0) {
-        chunk_length = int32(samp_freq * chunk_size);
-        if (chunk_length == 0)
-            chunk_length = 1;
-    } else {
-        chunk_length = std::numeric_limits<int32>::max();
-    }
-
-    int32 samp_offset = 0;
-    std::vector<std::pair<int32, kaldi::BaseFloat>> delta_weights;
-
-    while (samp_offset < data.Dim()) {
-        int32 samp_remaining = data.Dim() - samp_offset;
-        int32 num_samp = chunk_length < samp_remaining ? chunk_length : samp_remaining;
-
-        kaldi::SubVector<kaldi::BaseFloat> wave_part(data, samp_offset, num_samp);
-        _decode_wave(wave_part, delta_weights, samp_freq);
-
-        samp_offset += num_samp;
-    }
+    decode_audio(data, wave_data.SampFreq(), chunk_size);
 }
 
 void Decoder::decode_raw_wav_audio(std::istream &wav_stream,
                                    const float &samp_freq,
                                    const int &data_bytes,
                                    const float &chunk_size) {
-    kaldi::Matrix<kaldi::BaseFloat> wave_matrix;
-    read_raw_wav_stream(wav_stream, data_bytes, wave_matrix);
+    wav_bytes_.clear();
+    read_raw_wav_stream(wav_stream, data_bytes, wav_bytes_, wav_samples_);
 
-    // get the data for channel zero (if the signal is not mono, we only
-    // take the first channel).
-    kaldi::SubVector<kaldi::BaseFloat> data(wave_matrix, 0);
+    // raw audio is read as mono, so the whole buffer is channel zero.
+    kaldi::SubVector<kaldi::BaseFloat> data(wav_samples_.data(), wav_samples_.size());
+    decode_audio(data, samp_freq, chunk_size);
+}
 
+void Decoder::decode_audio(const kaldi::VectorBase<kaldi::BaseFloat> &audio,
+                           const float &samp_freq,
+                           const float &chunk_size) {
     int32 chunk_length;
     if (chunk_size > 0) {
         chunk_length = int32(samp_freq * chunk_size);
@@ -145,14 +197,14 @@ void Decoder::decode_raw_wav_audio(std::istream &wav_stream,
     }
 
     int32 samp_offset = 0;
-    std::vector<std::pair<int32, kaldi::BaseFloat>> delta_weights;
 
-    while (samp_offset < data.Dim()) {
-        int32 samp_remaining = data.Dim() - samp_offset;
+    while (samp_offset < audio.Dim() && !cancelled()) {
+        int32 samp_remaining = audio.Dim() - samp_offset;
         int32 num_samp = chunk_length < samp_remaining ? chunk_length : samp_remaining;
 
-        kaldi::SubVector<kaldi::BaseFloat> wave_part(data, samp_offset, num_samp);
-        _decode_wave(wave_part, delta_weights, samp_freq);
+        // (the samples' origin is unknown here, they are journaled as floats)
+        kaldi::SubVector<kaldi::BaseFloat> wave_part(audio, samp_offset, num_samp);
+        _decode_wave(wave_part, delta_weights_, samp_freq, false);
 
         samp_offset += num_samp;
     }
@@ -161,40 +213,345 @@ void Decoder::decode_raw_wav_audio(std::istream &wav_stream,
 void Decoder::get_decoded_results(const int &n_best,
                                   utterance_results_t &results,
                                   const bool &word_level,
-                                  const bool &bidi_streaming) {
+                                  const bool &bidi_streaming,
+                                  const bool &stable_words) {
     if (!bidi_streaming) {
-        feature_pipeline_->InputFinished();
-        decoder_->AdvanceDecoding();
+        const auto start = std::chrono::steady_clock::now();
+
+        // (a shared frontend is finished by its owner)
+        if (feature_pipeline_) feature_pipeline_->InputFinished();
+        if (!cancelled()) decoder_->AdvanceDecoding(decodable_);
         decoder_->FinalizeDecoding();
+
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        decoding_secs_ += elapsed.count();
     }
 
     if (decoder_->NumFramesDecoded() == 0) {
-        KALDI_WARN << "audio may be empty :: decoded no frames";
+        // partial results may be asked for before the first frames are decoded
+        if (!bidi_streaming) KALDI_WARN << "audio may be empty :: decoded no frames";
         return;
     }
 
     kaldi::CompactLattice clat;
     try {
-        decoder_->GetLattice(true, &clat);
+        _get_lattice(true, clat);
         find_alternatives(clat, n_best, results, word_level, model_, options);
+
+        // partial hypotheses are stable up to the words all the active paths agree on
+        // (only worked out on request, it determinizes the whole raw lattice)
+        int32 n_stable = std::numeric_limits<int32>::max();
+        if (bidi_streaming) {
+            n_stable = 0;
+            if (stable_words) {
+                kaldi::Lattice raw_lat;
+                decoder_->GetRawLattice(&raw_lat, false);
+                n_stable = _stable_words(raw_lat);
+            }
+        }
+
+        for (auto &alt : results) {
+            const int32 n_words = alt.transcript.empty() ? 0 : std::count(alt.transcript.begin(), alt.transcript.end(), ' ') + 1;
+            alt.stable_words = std::min(n_stable, n_words);
+        }
     } catch (std::exception &e) {
         KALDI_ERR << "unexpected error during decoding lattice :: " << e.what(); 
     }
 }
 
+kaldi::BaseFloat Decoder::best_path_score() {
+    const int32 n_frames = decoder_->NumFramesDecoded();
+    if (n_frames == 0) return -std::numeric_limits<kaldi::BaseFloat>::infinity();
+
+    kaldi::Lattice best_path;
+    decoder_->GetBestPath(&best_path, false);
+
+    std::vector<int32> alignment, words;
+    kaldi::LatticeWeight weight;
+    if (!fst::GetLinearSymbolSequence(best_path, &alignment, &words, &weight)) {
+        return -std::numeric_limits<kaldi::BaseFloat>::infinity();
+    }
+    return -(weight.Value1() + weight.Value2()) / n_frames;
+}
+
+void Decoder::cancel() noexcept {
+    cancelled_ = true;
+}
+
+void Decoder::clear_interruption() noexcept {
+    cancelled_ = false;
+    deadline_ = std::chrono::system_clock::time_point::max();
+    cancel_check_ = nullptr;
+}
+
+// strings are written as byte vectors (they may contain whitespace)
+static void write_string(std::ostream &os, const std::string &value) {
+    kaldi::WriteIntegerVector(os, true, std::vector<char>(value.begin(), value.end()));
+}
+
+static std::string read_string(std::istream &is) {
+    std::vector<char> value;
+    kaldi::ReadIntegerVector(is, true, &value);
+    return std::string(value.begin(), value.end());
+}
+
+void Decoder::snapshot(std::ostream &os) const {
+    const ModelSpec &spec = model_->model_spec;
+    if (!spec.enable_snapshots)
+        KALDI_ERR << "snapshots are not enabled for model " << spec.name << " (" << spec.language_code << ")";
+    if (decodable_ != NULL && feature_pipeline_ == NULL)
+        KALDI_ERR << "decoders on a shared frontend can't be snapshotted";
+
+    kaldi::WriteToken(os, true, "<DecoderSnapshot>");
+    write_string(os, spec.name);
+    write_string(os, spec.language_code);
+    write_string(os, uuid_);
+    kaldi::WriteBasicType(os, true, static_cast<int64>(processed_bytes_));
+    kaldi::WriteBasicType(os, true, history_samp_freq_);
+    kaldi::WriteIntegerVector(os, true, chunk_history_);
+
+    if (float_history_.empty()) {
+        kaldi::WriteToken(os, true, "<Pcm16>");
+        kaldi::WriteIntegerVector(os, true, pcm_history_);
+    } else {
+        kaldi::WriteToken(os, true, "<Float32>");
+        kaldi::WriteBasicType(os, true, static_cast<int32>(float_history_.size()));
+        os.write(reinterpret_cast<const char *>(float_history_.data()), float_history_.size() * sizeof(kaldi::BaseFloat));
+    }
+
+    kaldi::WriteIntegerVector(os, true, wav_bytes_);
+    wav_parser_.write(os);
+    kaldi::WriteToken(os, true, "</DecoderSnapshot>");
+
+    if (!os.good())
+        KALDI_ERR << "failed to write decoder snapshot";
+}
+
+void Decoder::restore(std::istream &is) {
+    const ModelSpec &spec = model_->model_spec;
+    if (!spec.enable_snapshots)
+        KALDI_ERR << "snapshots are not enabled for model " << spec.name << " (" << spec.language_code << ")";
+
+    int64 processed_bytes;
+    kaldi::BaseFloat samp_freq;
+    std::vector<int32> chunks;
+    std::vector<int16> pcm_samples;
+    std::vector<kaldi::BaseFloat> float_samples;
+    std::vector<char> pending_bytes;
+    WavStreamParser wav_parser;
+    std::string format;
+
+    kaldi::ExpectToken(is, true, "<DecoderSnapshot>");
+    const std::string name = read_string(is);
+    const std::string language_code = read_string(is);
+    if (name != spec.name || language_code != spec.language_code)
+        KALDI_ERR << "snapshot of model " << name << " (" << language_code << ") can't be restored on "
+                  << spec.name << " (" << spec.language_code << ")";
+
+    const std::string uuid = read_string(is);
+    kaldi::ReadBasicType(is, true, &processed_bytes);
+    kaldi::ReadBasicType(is, true, &samp_freq);
+    kaldi::ReadIntegerVector(is, true, &chunks);
+
+    kaldi::ReadToken(is, true, &format);
+    if (format == "<Pcm16>") {
+        kaldi::ReadIntegerVector(is, true, &pcm_samples);
+    } else if (format == "<Float32>") {
+        int32 n_samples;
+        kaldi::ReadBasicType(is, true, &n_samples);
+        float_samples.resize(n_samples);
+        is.read(reinterpret_cast<char *>(float_samples.data()), n_samples * sizeof(kaldi::BaseFloat));
+    } else {
+        KALDI_ERR << "unknown snapshot audio format " << format;
+    }
+
+    kaldi::ReadIntegerVector(is, true, &pending_bytes);
+    wav_parser.read(is);
+    kaldi::ExpectToken(is, true, "</DecoderSnapshot>");
+
+    const std::size_t n_samples = float_samples.empty() ? pcm_samples.size() : float_samples.size();
+    std::size_t n_chunk_samples = 0;
+    for (auto const &chunk : chunks) n_chunk_samples += chunk;
+    if (n_chunk_samples != n_samples)
+        KALDI_ERR << "corrupt decoder snapshot :: " << n_chunk_samples << " chunked samples, " << n_samples << " samples";
+
+    // replay the audio in the original chunks so that the search and the
+    // silence weighting updates happen at the same points
+    start_decoding(uuid);
+
+    const bool pcm16 = float_samples.empty();
+    std::size_t offset = 0;
+    for (auto const &chunk : chunks) {
+        if (pcm16) {
+            wav_samples_.assign(pcm_samples.begin() + offset, pcm_samples.begin() + offset + chunk);
+        } else {
+            wav_samples_.assign(float_samples.begin() + offset, float_samples.begin() + offset + chunk);
+        }
+        offset += chunk;
+
+        kaldi::SubVector<kaldi::BaseFloat> wave_part(wav_samples_.data(), chunk);
+        _decode_wave(wave_part, delta_weights_, samp_freq, pcm16);
+    }
+
+    processed_bytes_ = processed_bytes;
+    wav_bytes_.swap(pending_bytes);
+    wav_parser_ = wav_parser;
+}
+
+void Decoder::_record_audio(const kaldi::VectorBase<kaldi::BaseFloat> &wave_part,
+                            const kaldi::BaseFloat &samp_freq,
+                            const bool &pcm16) {
+    if (chunk_history_.empty()) {
+        history_samp_freq_ = samp_freq;
+    } else if (samp_freq != history_samp_freq_) {
+        KALDI_ERR << "sampling frequency changed from " << history_samp_freq_ << " to " << samp_freq
+                  << " within an utterance (not supported with snapshots)";
+    }
+    chunk_history_.push_back(wave_part.Dim());
+
+    // chunks are appended in bulk (converted by the range insert)
+    const kaldi::BaseFloat *begin = wave_part.Data();
+    const kaldi::BaseFloat *end = begin + wave_part.Dim();
+    if (pcm16 && float_history_.empty()) {
+        pcm_history_.insert(pcm_history_.end(), begin, end);
+        return;
+    }
+
+    // switch over to float samples for the rest of the utterance
+    if (!pcm_history_.empty()) {
+        float_history_.assign(pcm_history_.begin(), pcm_history_.end());
+        pcm_history_.clear();
+        pcm_history_.shrink_to_fit();
+    }
+    float_history_.insert(float_history_.end(), begin, end);
+}
+
+void Decoder::set_deadline(const std::chrono::system_clock::time_point &deadline) noexcept {
+    deadline_ = deadline;
+}
+
+void Decoder::set_cancel_check(const std::function<bool()> &cancel_check) noexcept {
+    cancel_check_ = cancel_check;
+}
+
+bool Decoder::cancelled() noexcept {
+    if (!cancelled_ && (std::chrono::system_clock::now() > deadline_ || (cancel_check_ && cancel_check_()))) {
+        cancelled_ = true;
+    }
+    return cancelled_;
+}
+
 void Decoder::_decode_wave(kaldi::SubVector<kaldi::BaseFloat> &wave_part,
                            std::vector<std::pair<int32, kaldi::BaseFloat>> &delta_weights,
-                           const kaldi::BaseFloat &samp_freq) {
-    feature_pipeline_->AcceptWaveform(samp_freq, wave_part);
+                           const kaldi::BaseFloat &samp_freq,
+                           const bool &pcm16) {
+    if (feature_pipeline_ == NULL)
+        KALDI_ERR << "decoder reads the features of a shared frontend, its audio goes to the frontend";
+
+    if (model_->model_spec.enable_snapshots) _record_audio(wave_part, samp_freq, pcm16);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // once started, a chunk is always taken in whole (only the search stops
+    // on interruption) so that the processed audio ends on chunk boundaries
+    const bool silence_weighting = silence_weighting_->Active() && feature_pipeline_->IvectorFeature() != NULL;
+    const int32 weighting_period = int32(samp_freq * model_->model_spec.silence_weighting_period);
+
+    if (!silence_weighting || weighting_period <= 0) {
+        feature_pipeline_->AcceptWaveform(samp_freq, wave_part);
+
+        // the search only runs once enough new frames are ready, small chunks
+        // (e.g. 20ms packets) just accumulate their features until then
+        if (decodable_->NumFramesReady() - decoder_->NumFramesDecoded() >= advance_frames_) {
+            if (silence_weighting) _update_silence_weights(delta_weights);
+            _advance_decoding();
+        }
+    } else {
+        // silence weights are updated once every `weighting_period` samples
+        // irrespective of the chunking, larger chunks are split at the updates
+        int32 samp_offset = 0;
+        while (samp_offset < wave_part.Dim()) {
+            int32 samp_remaining = wave_part.Dim() - samp_offset;
+            int32 num_samp = std::min(samp_remaining, weighting_period - samples_since_weighting_);
+
+            kaldi::SubVector<kaldi::BaseFloat> wave_piece(wave_part, samp_offset, num_samp);
+            feature_pipeline_->AcceptWaveform(samp_freq, wave_piece);
+
+            samp_offset += num_samp;
+            samples_since_weighting_ += num_samp;
+
+            if (samples_since_weighting_ >= weighting_period) {
+                _update_silence_weights(delta_weights);
+                samples_since_weighting_ = 0;
+            }
+
+            if (decodable_->NumFramesReady() - decoder_->NumFramesDecoded() >= advance_frames_) {
+                _advance_decoding();
+            }
+        }
+    }
 
-    if (silence_weighting_->Active() && feature_pipeline_->IvectorFeature() != NULL) {
-        silence_weighting_->ComputeCurrentTraceback(decoder_->Decoder());
-        silence_weighting_->GetDeltaWeights(feature_pipeline_->NumFramesReady(),
-                                            &delta_weights);
-        feature_pipeline_->IvectorFeature()->UpdateFrameWeights(delta_weights);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    decoding_secs_ += elapsed.count();
+    audio_secs_ += wave_part.Dim() / samp_freq;
+}
+
+void Decoder::_update_silence_weights(std::vector<std::pair<int32, kaldi::BaseFloat>> &delta_weights) {
+    silence_weighting_->ComputeCurrentTraceback(*decoder_);
+    silence_weighting_->GetDeltaWeights(feature_pipeline_->NumFramesReady(),
+                                        &delta_weights);
+    feature_pipeline_->IvectorFeature()->UpdateFrameWeights(delta_weights);
+}
+
+void Decoder::_advance_decoding() {
+    if (cancelled()) return;
+
+    const int quantum_frames = model_->model_spec.quantum_frames;
+    if (quantum_frames <= 0) {
+        decoder_->AdvanceDecoding(decodable_);
+        return;
     }
 
-    decoder_->AdvanceDecoding();
+    // decode in quanta of frames so that higher priority work waiting
+    // on the worker pool gets to run in between
+    while (decoder_->NumFramesDecoded() < decodable_->NumFramesReady() && !cancelled()) {
+        decoder_->AdvanceDecoding(decodable_, quantum_frames);
+        WorkerPool::yield();
+    }
+}
+
+int32 Decoder::_stable_words(const kaldi::Lattice &raw_lat) const {
+    // word acceptor of all the paths (weights don't matter here)
+    fst::VectorFst<fst::StdArc> word_fst;
+    fst::ConvertLattice(raw_lat, &word_fst);
+    fst::Project(&word_fst, fst::PROJECT_OUTPUT);
+    fst::RmEpsilon(&word_fst);
+
+    fst::VectorFst<fst::StdArc> det_word_fst;
+    fst::Determinize(word_fst, &det_word_fst);
+    fst::Connect(&det_word_fst);
+
+    // the shared prefix is the chain of single arc states from the start
+    int32 stable_words = 0;
+    auto state = det_word_fst.Start();
+    while (state != fst::kNoStateId &&
+           det_word_fst.NumArcs(state) == 1 &&
+           det_word_fst.Final(state) == fst::StdArc::Weight::Zero()) {
+        fst::ArcIterator<fst::VectorFst<fst::StdArc>> arc_iter(det_word_fst, state);
+        state = arc_iter.Value().nextstate;
+        stable_words++;
+    }
+    return stable_words;
+}
+
+void Decoder::_get_lattice(const bool &end_of_utterance,
+                           kaldi::CompactLattice &clat) const {
+    kaldi::Lattice raw_lat;
+    decoder_->GetRawLattice(&raw_lat, end_of_utterance);
+
+    kaldi::DeterminizeLatticePhonePrunedWrapper(model_->trans_model, &raw_lat,
+                                                model_->lattice_faster_decoder_config.lattice_beam,
+                                                &clat, model_->lattice_faster_decoder_config.det_opts);
 }
 
 } // namespace kaldiserve
\ No newline at end of file
@@ -0,0 +1,219 @@
+// feature-frontend.cpp - Shared Feature Frontend Implementation
+
+// stl includes
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <limits>
+
+// local includes
+#include "config.hpp"
+#include "decoder.hpp"
+#include "feature.hpp"
+#include "types.hpp"
+#include "worker.hpp"
+
+
+namespace kaldiserve {
+
+kaldi::int32 LockedFeature::Dim() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return feature_->Dim();
+}
+
+kaldi::int32 LockedFeature::NumFramesReady() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return feature_->NumFramesReady();
+}
+
+bool LockedFeature::IsLastFrame(kaldi::int32 frame) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return feature_->IsLastFrame(frame);
+}
+
+kaldi::BaseFloat LockedFeature::FrameShiftInSeconds() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return feature_->FrameShiftInSeconds();
+}
+
+void LockedFeature::GetFrame(kaldi::int32 frame, kaldi::VectorBase<kaldi::BaseFloat> *feat) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    feature_->GetFrame(frame, feat);
+}
+
+void LockedFeature::GetFrames(const std::vector<kaldi::int32> &frames, kaldi::MatrixBase<kaldi::BaseFloat> *feats) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    feature_->GetFrames(frames, feats);
+}
+
+SharedFrontend::SharedFrontend(const std::vector<Decoder*> &decoders, const std::string &uuid)
+    : decoders_(decoders), race_(nullptr), audio_secs_(0) {
+    if (decoders_.empty()) KALDI_ERR << "shared frontend needs at least one decoder";
+
+    const Decoder *first = decoders_.front();
+    const ModelSpec &first_spec = first->model_spec();
+
+    for (auto const &decoder : decoders_) {
+        const ModelSpec &spec = decoder->model_spec();
+        const bool same_model = spec.name == first_spec.name && spec.language_code == first_spec.language_code;
+        if (!same_model && (spec.feature_group.empty() || spec.feature_group != first_spec.feature_group)) {
+            KALDI_ERR << "model " << spec.name << " (" << spec.language_code << ") is not in the feature group of model "
+                      << first_spec.name << " (" << first_spec.language_code << ")";
+        }
+        // a feature group only promises the same config, catch the obvious mismatches
+        if (decoder->samp_freq() != first->samp_freq() || spec.feature_type != first_spec.feature_type ||
+            spec.use_ivectors != first_spec.use_ivectors || spec.add_pitch != first_spec.add_pitch) {
+            KALDI_ERR << "model " << spec.name << " (" << spec.language_code << ") has other features than model "
+                      << first_spec.name << " (" << first_spec.language_code << ")";
+        }
+    }
+
+    feature_pipeline_.reset(new kaldi::OnlineNnet2FeaturePipeline(first->feature_info()));
+
+    if (first->feature_info().use_ivectors) {
+        adaptation_state_.reset(new kaldi::OnlineIvectorExtractorAdaptationState(first->feature_info().ivector_extractor_info));
+        feature_pipeline_->SetAdaptationState(*adaptation_state_);
+    }
+
+    input_feature_.reset(new LockedFeature(feature_pipeline_->InputFeature(), mutex_));
+    if (feature_pipeline_->IvectorFeature() != NULL) {
+        ivector_feature_.reset(new LockedFeature(feature_pipeline_->IvectorFeature(), mutex_));
+    }
+
+    // (i-vectors aren't silence weighted, the decoders' tracebacks would disagree on the weights)
+    for (auto &decoder : decoders_) decoder->start_decoding(uuid, this);
+}
+
+SharedFrontend::~SharedFrontend() {
+    for (auto &decoder : decoders_) decoder->free_decoder();
+}
+
+void SharedFrontend::decode_chunk(const kaldi::VectorBase<kaldi::BaseFloat> &wave_part,
+                                  const kaldi::BaseFloat &samp_freq,
+                                  WorkerPool *const worker_pool) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        feature_pipeline_->AcceptWaveform(samp_freq, wave_part);
+    }
+
+    // features are computed on demand by the first decoder to read them,
+    // the others find them in the pipeline's cache
+    const kaldi::BaseFloat chunk_secs = wave_part.Dim() / samp_freq;
+    audio_secs_ += chunk_secs;
+    for_each_decoder_([this, &chunk_secs](Decoder *const decoder) {
+        decoder->decode_shared_chunk(chunk_secs);
+        if (race_ == nullptr) return;
+        // a decoder stopped by its deadline or the client won't report again
+        if (decoder->cancelled()) {
+            race_->withdraw(decoder);
+        } else {
+            race_->report(decoder, audio_secs_);
+        }
+    }, worker_pool);
+}
+
+void SharedFrontend::decode_audio(const kaldi::VectorBase<kaldi::BaseFloat> &audio,
+                                  const kaldi::BaseFloat &samp_freq,
+                                  const float &chunk_size,
+                                  WorkerPool *const worker_pool) {
+    int32 chunk_length;
+    if (chunk_size > 0) {
+        chunk_length = int32(samp_freq * chunk_size);
+        if (chunk_length == 0)
+            chunk_length = 1;
+    } else {
+        chunk_length = std::numeric_limits<int32>::max();
+    }
+
+    int32 samp_offset = 0;
+
+    while (samp_offset < audio.Dim() && !cancelled()) {
+        int32 samp_remaining = audio.Dim() - samp_offset;
+        int32 num_samp = chunk_length < samp_remaining ? chunk_length : samp_remaining;
+
+        kaldi::SubVector<kaldi::BaseFloat> wave_part(audio, samp_offset, num_samp);
+        decode_chunk(wave_part, samp_freq, worker_pool);
+
+        samp_offset += num_samp;
+    }
+}
+
+void SharedFrontend::decode_wav_audio(std::istream &wav_stream,
+                                      const float &chunk_size,
+                                      WorkerPool *const worker_pool) {
+    kaldi::WaveData wave_data;
+    wave_data.Read(wav_stream);
+
+    // only the first channel is decoded
+    kaldi::SubVector<kaldi::BaseFloat> data(wave_data.Data(), 0);
+    decode_audio(data, wave_data.SampFreq(), chunk_size, worker_pool);
+}
+
+void SharedFrontend::decode_raw_wav_audio(std::istream &wav_stream,
+                                          const float &samp_freq,
+                                          const int &data_bytes,
+                                          const float &chunk_size,
+                                          WorkerPool *const worker_pool) {
+    std::vector<char> wav_bytes;
+    std::vector<kaldi::BaseFloat> wav_samples;
+    read_raw_wav_stream(wav_stream, data_bytes, wav_bytes, wav_samples);
+
+    kaldi::SubVector<kaldi::BaseFloat> data(wav_samples.data(), wav_samples.size());
+    decode_audio(data, samp_freq, chunk_size, worker_pool);
+}
+
+void SharedFrontend::input_finished() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    feature_pipeline_->InputFinished();
+}
+
+void SharedFrontend::get_decoded_results(const int &n_best,
+                                         std::vector<utterance_results_t> &results,
+                                         const bool &word_level,
+                                         WorkerPool *const worker_pool) {
+    input_finished();
+
+    results.assign(decoders_.size(), utterance_results_t());
+    for_each_decoder_([&](Decoder *const decoder) {
+        const std::size_t i = std::find(decoders_.begin(), decoders_.end(), decoder) - decoders_.begin();
+        if (!decoder->cancelled()) decoder->get_decoded_results(n_best, results[i], word_level);
+    }, worker_pool);
+}
+
+bool SharedFrontend::cancelled() noexcept {
+    for (auto &decoder : decoders_) {
+        if (!decoder->cancelled()) return false;
+    }
+    return true;
+}
+
+void SharedFrontend::for_each_decoder_(const std::function<void(Decoder *const)> &task, WorkerPool *const worker_pool) {
+    if (decoders_.size() == 1) {
+        task(decoders_.front());
+        return;
+    }
+
+    // a pool without workers would run the tasks one after the other
+    std::vector<std::future<void>> futures;
+    for (auto &decoder : decoders_) {
+        Decoder *const d = decoder;
+        if (worker_pool != nullptr && worker_pool->size() > 0) {
+            futures.push_back(worker_pool->submit([&task, d]() { task(d); }, d->numa_node()));
+        } else {
+            futures.push_back(std::async(std::launch::async, [&task, d]() { task(d); }));
+        }
+    }
+
+    // every task is waited for (they reference the frontend) before rethrowing
+    std::exception_ptr error;
+    for (auto &future : futures) {
+        try {
+            future.get();
+        } catch (...) {
+            if (!error) error = std::current_exception();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+} // namespace kaldiserve
\ No newline at end of file
@@ -22,7 +22,8 @@ ChainModel::ChainModel(const ModelSpec &model_spec) : model_spec(model_spec) {
         std::string word_boundary_filepath = join_path(model_dir, "word_boundary.int");
 
         std::string conf_dir = join_path(model_dir, "conf");
-        std::string mfcc_conf_filepath = join_path(conf_dir, "mfcc.conf");
+        std::string feature_conf_filepath = join_path(conf_dir, model_spec.feature_type + ".conf");
+        std::string pitch_conf_filepath = join_path(conf_dir, "pitch.conf");
         std::string ivector_conf_filepath = join_path(conf_dir, "ivector_extractor.conf");
 
         std::string rnnlm_dir = join_path(model_dir, "rnnlm");
@@ -78,23 +79,43 @@ ChainModel::ChainModel(const ModelSpec &model_spec) : model_spec(model_spec) {
         }
 
         feature_info = make_uniq<kaldi::OnlineNnet2FeaturePipelineInfo>();
-        feature_info->feature_type = "mfcc";
-        kaldi::ReadConfigFromFile(mfcc_conf_filepath, &(feature_info->mfcc_opts));
-
-        feature_info->use_ivectors = true;
-        kaldi::OnlineIvectorExtractionConfig ivector_extraction_opts;
-        kaldi::ReadConfigFromFile(ivector_conf_filepath, &ivector_extraction_opts);
-
-        // Expand paths if relative provided. We use model_dir as the base in
-        // such cases.
-        ivector_extraction_opts.lda_mat_rxfilename = expand_relative_path(ivector_extraction_opts.lda_mat_rxfilename, model_dir);
-        ivector_extraction_opts.global_cmvn_stats_rxfilename = expand_relative_path(ivector_extraction_opts.global_cmvn_stats_rxfilename, model_dir);
-        ivector_extraction_opts.diag_ubm_rxfilename = expand_relative_path(ivector_extraction_opts.diag_ubm_rxfilename, model_dir);
-        ivector_extraction_opts.ivector_extractor_rxfilename = expand_relative_path(ivector_extraction_opts.ivector_extractor_rxfilename, model_dir);
-        ivector_extraction_opts.cmvn_config_rxfilename = expand_relative_path(ivector_extraction_opts.cmvn_config_rxfilename, model_dir);
-        ivector_extraction_opts.splice_config_rxfilename = expand_relative_path(ivector_extraction_opts.splice_config_rxfilename, model_dir);
-
-        feature_info->ivector_extractor_info.Init(ivector_extraction_opts);
+        feature_info->feature_type = model_spec.feature_type;
+        if (model_spec.feature_type == "mfcc") {
+            kaldi::ReadConfigFromFile(feature_conf_filepath, &(feature_info->mfcc_opts));
+            samp_freq = feature_info->mfcc_opts.frame_opts.samp_freq;
+        } else if (model_spec.feature_type == "fbank") {
+            kaldi::ReadConfigFromFile(feature_conf_filepath, &(feature_info->fbank_opts));
+            samp_freq = feature_info->fbank_opts.frame_opts.samp_freq;
+        } else if (model_spec.feature_type == "plp") {
+            kaldi::ReadConfigFromFile(feature_conf_filepath, &(feature_info->plp_opts));
+            samp_freq = feature_info->plp_opts.frame_opts.samp_freq;
+        } else {
+            KALDI_ERR << "Unsupported feature type " << model_spec.feature_type << " (expected mfcc, fbank or plp)";
+        }
+
+        // the pitch config holds both the extraction and the post-processing options
+        feature_info->add_pitch = model_spec.add_pitch;
+        if (model_spec.add_pitch) {
+            kaldi::ReadConfigsFromFile(pitch_conf_filepath, &(feature_info->pitch_opts), &(feature_info->pitch_process_opts));
+        }
+
+        // models without i-vectors skip their extraction (and silence weighting) altogether
+        feature_info->use_ivectors = model_spec.use_ivectors;
+        if (model_spec.use_ivectors) {
+            kaldi::OnlineIvectorExtractionConfig ivector_extraction_opts;
+            kaldi::ReadConfigFromFile(ivector_conf_filepath, &ivector_extraction_opts);
+
+            // Expand paths if relative provided. We use model_dir as the base in
+            // such cases.
+            ivector_extraction_opts.lda_mat_rxfilename = expand_relative_path(ivector_extraction_opts.lda_mat_rxfilename, model_dir);
+            ivector_extraction_opts.global_cmvn_stats_rxfilename = expand_relative_path(ivector_extraction_opts.global_cmvn_stats_rxfilename, model_dir);
+            ivector_extraction_opts.diag_ubm_rxfilename = expand_relative_path(ivector_extraction_opts.diag_ubm_rxfilename, model_dir);
+            ivector_extraction_opts.ivector_extractor_rxfilename = expand_relative_path(ivector_extraction_opts.ivector_extractor_rxfilename, model_dir);
+            ivector_extraction_opts.cmvn_config_rxfilename = expand_relative_path(ivector_extraction_opts.cmvn_config_rxfilename, model_dir);
+            ivector_extraction_opts.splice_config_rxfilename = expand_relative_path(ivector_extraction_opts.splice_config_rxfilename, model_dir);
+
+            feature_info->ivector_extractor_info.Init(ivector_extraction_opts);
+        }
         feature_info->silence_weighting_config.silence_weight = model_spec.silence_weight;
 
         lattice_faster_decoder_config.min_active = model_spec.min_active;
@@ -104,6 +125,7 @@ ChainModel::ChainModel(const ModelSpec &model_spec) : model_spec(model_spec) {
 
         decodable_opts.acoustic_scale = model_spec.acoustic_scale;
         decodable_opts.frame_subsampling_factor = model_spec.frame_subsampling_factor;
+        decodable_opts.frames_per_chunk = model_spec.frames_per_chunk;
         decodable_info = make_uniq<kaldi::nnet3::DecodableNnetSimpleLoopedInfo>(decodable_opts, &am_nnet);
     
     } catch (const std::exception &e) {
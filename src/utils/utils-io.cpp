@@ -1,5 +1,11 @@
 // utils-io.cpp - I/O Utilities Implementation
 
+// stl includes
+#include <fstream>
+#include <future>
+#include <map>
+#include <set>
+
 // lib includes
 #include <boost/filesystem.hpp>
 
@@ -34,54 +40,334 @@ bool exists(std::string path) {
   return boost::filesystem::exists(fs_path);
 }
 
-void parse_model_specs(const std::string &toml_path, std::vector<ModelSpec> &model_specs) {
-    auto config = cpptoml::parse_file(toml_path);
-    auto models = config->get_table_array("model");
-
-    ModelSpec spec;
-    for (const auto &model : *models) {
-        auto maybe_path = model->get_as<std::string>("path");
-        auto maybe_name = model->get_as<std::string>("name");
-        auto maybe_language_code = model->get_as<std::string>("language_code");
-        auto maybe_n_decoders = model->get_as<int>("n_decoders");
-
-        auto maybe_min_active = model->get_as<int>("min_active");
-        auto maybe_max_active = model->get_as<int>("max_active");
-        auto maybe_frame_subsampling_factor = model->get_as<int>("frame_subsampling_factor");
-        auto maybe_beam = model->get_as<double>("beam");
-        auto maybe_lattice_beam = model->get_as<double>("lattice_beam");
-        auto maybe_acoustic_scale = model->get_as<double>("acoustic_scale");
-        auto maybe_silence_weight = model->get_as<double>("silence_weight");
-        auto maybe_max_ngram_order = model->get_as<int>("max_ngram_order");
-        auto maybe_rnnlm_weight = model->get_as<double>("rnnlm_weight");
-        auto maybe_bos_index = model->get_as<std::string>("bos_index");
-        auto maybe_eos_index = model->get_as<std::string>("eos_index");
-
-        // TODO: Throw error in case of invalid toml
-        spec.path = *maybe_path;
-        spec.name = *maybe_name;
-        spec.language_code = *maybe_language_code;
-
-        if (maybe_n_decoders) spec.n_decoders = *maybe_n_decoders;
-        if (maybe_beam) spec.beam = *maybe_beam;
-        if (maybe_min_active) spec.min_active = *maybe_min_active;
-        if (maybe_max_active) spec.max_active = *maybe_max_active;
-        if (maybe_lattice_beam) spec.lattice_beam = *maybe_lattice_beam;
-        if (maybe_acoustic_scale) spec.acoustic_scale = *maybe_acoustic_scale;
-        if (maybe_frame_subsampling_factor) spec.frame_subsampling_factor = *maybe_frame_subsampling_factor;
-        if (maybe_silence_weight) spec.silence_weight = *maybe_silence_weight;
-        if (maybe_max_ngram_order) spec.max_ngram_order = *maybe_max_ngram_order;
-        if (maybe_rnnlm_weight) spec.rnnlm_weight = *maybe_rnnlm_weight;
-        if (maybe_bos_index) spec.bos_index = *maybe_bos_index;
-        if (maybe_eos_index) spec.eos_index = *maybe_eos_index;
-
-        model_specs.push_back(spec);
+// Reads the keys of a toml table into spec fields. Problems (missing required
+// keys, values of the wrong type or out of range, unknown keys) are collected
+// as messages rather than stopping at the first one.
+class TableReader final {
+
+  public:
+    TableReader(const std::shared_ptr<cpptoml::table> &table, const std::string &where,
+                std::vector<std::string> &errors)
+        : table_(table), where_(where), errors_(errors) {}
+
+    // reads `key` (of toml type `T`) into `value` if present
+    template <typename T, typename V>
+    void read(const std::string &key, V &value, const bool &required = false) {
+        keys_.insert(key);
+
+        if (!table_->contains(key)) {
+            if (required) error("missing required key `" + key + "`");
+            return;
+        }
+
+        cpptoml::option<T> maybe_value;
+        try {
+            maybe_value = table_->get_as<T>(key);
+        } catch (const std::exception &) {
+            // integers out of range
+        }
+
+        if (maybe_value) {
+            value = *maybe_value;
+        } else {
+            error("`" + key + "` should be " + type_name_(T()));
+        }
+    }
+
+    // tells if the table sets `key`
+    bool has(const std::string &key) const {
+        return table_->contains(key);
+    }
+
+    // reports `message` unless the condition holds
+    void check(const bool &condition, const std::string &message) {
+        if (!condition) error(message);
+    }
+
+    void error(const std::string &message) {
+        errors_.push_back(where_ + ": " + message);
+    }
+
+    // reports the keys of the table that were not read (typos, stale options)
+    void check_unknown_keys() {
+        for (auto const &entry : *table_) {
+            if (keys_.find(entry.first) == keys_.end()) error("unknown key `" + entry.first + "`");
+        }
+    }
+
+  private:
+    static std::string type_name_(const int &) { return "an integer"; }
+    static std::string type_name_(const double &) { return "a number"; }
+    static std::string type_name_(const bool &) { return "a boolean"; }
+    static std::string type_name_(const std::string &) { return "a string"; }
+
+    std::shared_ptr<cpptoml::table> table_;
+    const std::string where_;
+    std::vector<std::string> &errors_;
+    std::set<std::string> keys_;
+};
+
+// Fills the feature options the model spec leaves unset from the configs
+// present in the model's `conf` directory.
+static void detect_features(const TableReader &reader, ModelSpec &spec) {
+    const std::string conf_dir = join_path(spec.path, "conf");
+
+    if (!reader.has("feature_type")) {
+        for (auto const &feature_type : {"mfcc", "fbank", "plp"}) {
+            if (exists(join_path(conf_dir, std::string(feature_type) + ".conf"))) {
+                spec.feature_type = feature_type;
+                break;
+            }
+        }
     }
+    if (!reader.has("use_ivectors")) spec.use_ivectors = exists(join_path(conf_dir, "ivector_extractor.conf"));
+    if (!reader.has("add_pitch")) spec.add_pitch = exists(join_path(conf_dir, "pitch.conf"));
+}
+
+static void read_model_spec(const std::shared_ptr<cpptoml::table> &model, const std::string &where,
+                            ModelSpec &spec, std::vector<std::string> &errors) {
+    TableReader reader(model, where, errors);
+
+    reader.read<std::string>("name", spec.name, true);
+    reader.read<std::string>("language_code", spec.language_code, true);
+    reader.read<std::string>("path", spec.path, true);
+    reader.read<int>("n_decoders", spec.n_decoders);
+
+    reader.read<int>("min_active", spec.min_active);
+    reader.read<int>("max_active", spec.max_active);
+    reader.read<int>("frame_subsampling_factor", spec.frame_subsampling_factor);
+    reader.read<int>("frames_per_chunk", spec.frames_per_chunk);
+    reader.read<double>("beam", spec.beam);
+    reader.read<double>("lattice_beam", spec.lattice_beam);
+    reader.read<double>("acoustic_scale", spec.acoustic_scale);
+    reader.read<double>("silence_weight", spec.silence_weight);
+    reader.read<std::string>("feature_type", spec.feature_type);
+    reader.read<bool>("use_ivectors", spec.use_ivectors);
+    reader.read<bool>("add_pitch", spec.add_pitch);
+    reader.read<std::string>("feature_group", spec.feature_group);
+    reader.read<int>("max_ngram_order", spec.max_ngram_order);
+    reader.read<double>("rnnlm_weight", spec.rnnlm_weight);
+    reader.read<std::string>("bos_index", spec.bos_index);
+    reader.read<std::string>("eos_index", spec.eos_index);
+    reader.read<double>("chunk_size", spec.chunk_size);
+    reader.read<bool>("auto_chunk_size", spec.auto_chunk_size);
+    reader.read<double>("silence_weighting_period", spec.silence_weighting_period);
+    reader.read<int>("advance_frames", spec.advance_frames);
+    reader.read<bool>("enable_snapshots", spec.enable_snapshots);
+    reader.read<int>("quantum_frames", spec.quantum_frames);
+    reader.read<bool>("numa_replicate", spec.numa_replicate);
+    reader.check_unknown_keys();
+
+    if (!spec.path.empty()) detect_features(reader, spec);
+
+    reader.check(spec.feature_type == "mfcc" || spec.feature_type == "fbank" || spec.feature_type == "plp",
+                 "`feature_type` should be one of mfcc, fbank or plp");
+    reader.check(spec.n_decoders >= 1, "`n_decoders` should be at least 1");
+    reader.check(spec.min_active > 0, "`min_active` should be positive");
+    reader.check(spec.max_active >= spec.min_active, "`max_active` should be at least `min_active`");
+    reader.check(spec.frame_subsampling_factor > 0, "`frame_subsampling_factor` should be positive");
+    reader.check(spec.frames_per_chunk > 0, "`frames_per_chunk` should be positive");
+    reader.check(spec.beam > 0, "`beam` should be positive");
+    reader.check(spec.lattice_beam > 0, "`lattice_beam` should be positive");
+    reader.check(spec.acoustic_scale > 0, "`acoustic_scale` should be positive");
+    reader.check(spec.max_ngram_order > 0, "`max_ngram_order` should be positive");
+    reader.check(spec.advance_frames >= 0, "`advance_frames` can't be negative");
+    reader.check(spec.quantum_frames >= 0, "`quantum_frames` can't be negative");
+}
+
+static void read_server_spec(const std::shared_ptr<cpptoml::table> &server,
+                             ServerSpec &server_spec, std::vector<std::string> &errors) {
+    TableReader reader(server, "[server]", errors);
+
+    reader.read<int>("n_workers", server_spec.n_workers);
+    reader.read<bool>("pin_workers", server_spec.pin_workers);
+    reader.read<double>("session_ttl", server_spec.session_ttl);
+    reader.read<double>("job_ttl", server_spec.job_ttl);
+    reader.read<std::string>("audio_root", server_spec.audio_root);
+    reader.read<std::string>("compression", server_spec.compression);
+    reader.read<double>("drain_timeout", server_spec.drain_timeout);
+    reader.read<std::string>("address", server_spec.address);
+    reader.read<bool>("lazy_load", server_spec.lazy_load);
+    reader.read<double>("memory_budget", server_spec.memory_budget);
+    reader.check_unknown_keys();
+
+    reader.check(server_spec.n_workers >= 0, "`n_workers` can't be negative");
+    reader.check(server_spec.session_ttl >= 0, "`session_ttl` can't be negative");
+    reader.check(server_spec.job_ttl >= 0, "`job_ttl` can't be negative");
+    reader.check(server_spec.compression.empty() || server_spec.compression == "none" ||
+                 server_spec.compression == "gzip" || server_spec.compression == "deflate",
+                 "`compression` should be one of none, gzip or deflate");
+    reader.check(server_spec.drain_timeout >= 0, "`drain_timeout` can't be negative");
+    reader.check(!server_spec.address.empty(), "`address` can't be empty");
+    reader.check(server_spec.memory_budget >= 0, "`memory_budget` can't be negative");
+    reader.check(server_spec.audio_root.empty() || exists(server_spec.audio_root),
+                 "`audio_root` " + server_spec.audio_root + " does not exist");
+}
+
+std::vector<std::string> model_artefact_errors(const ModelSpec &model_spec) {
+    std::vector<std::string> errors;
+    const std::string where = "model " + model_spec.name + " (" + model_spec.language_code + ")";
+
+    if (!boost::filesystem::is_directory(model_spec.path)) {
+        errors.push_back(where + ": model directory " + model_spec.path + " not found");
+        return errors;
+    }
+
+    std::vector<std::string> artefacts = {
+        "HCLG.fst", "final.mdl", "words.txt", join_path("conf", model_spec.feature_type + ".conf")
+    };
+    if (model_spec.use_ivectors) artefacts.push_back(join_path("conf", "ivector_extractor.conf"));
+    if (model_spec.add_pitch) artefacts.push_back(join_path("conf", "pitch.conf"));
+    for (auto const &artefact : artefacts) {
+        if (!exists(join_path(model_spec.path, artefact))) {
+            errors.push_back(where + ": " + artefact + " not found in " + model_spec.path);
+        }
+    }
+    return errors;
+}
+
+// Reads a model's i-vector extractor config (`--option=value` lines) with its
+// file options resolved against the model directory, the way the model loads
+// them, so that models sharing an extractor get the same options.
+static std::map<std::string, std::string> ivector_extractor_options(const ModelSpec &model_spec) {
+    static const std::set<std::string> path_options = {
+        "--lda-matrix", "--global-cmvn-stats", "--diagonal-ubm",
+        "--ivector-extractor", "--cmvn-config", "--splice-config"
+    };
+
+    std::map<std::string, std::string> options;
+    std::ifstream conf_file(join_path(join_path(model_spec.path, "conf"), "ivector_extractor.conf"));
+    std::string line;
+    while (std::getline(conf_file, line)) {
+        line = line.substr(0, line.find('#'));
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+        if (line.empty()) continue;
+
+        const std::size_t eq = line.find('=');
+        const std::string key = line.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : line.substr(eq + 1);
+        if (path_options.count(key) != 0) {
+            value = expand_relative_path(value, model_spec.path);
+            boost::system::error_code ec;
+            const boost::filesystem::path canonical_path = boost::filesystem::canonical(value, ec);
+            if (!ec) value = canonical_path.string();
+        }
+        options[key] = value;
+    }
+    return options;
+}
+
+static std::string config_error_message(const std::string &toml_path, const std::vector<std::string> &errors) {
+    std::string errors_str;
+    string_join(errors, "\n  - ", errors_str);
+    return "invalid config " + toml_path + ":\n  - " + errors_str;
+}
+
+ConfigError::ConfigError(const std::string &toml_path, const std::vector<std::string> &errors)
+    : std::runtime_error(config_error_message(toml_path, errors)), errors_(errors) {}
+
+void parse_config(const std::string &toml_path, std::vector<ModelSpec> &model_specs, ServerSpec &server_spec) {
+    std::shared_ptr<cpptoml::table> config;
+    try {
+        config = cpptoml::parse_file(toml_path);
+    } catch (const cpptoml::parse_exception &e) {
+        throw ConfigError(toml_path, {e.what()});
+    }
+
+    std::vector<std::string> errors;
+
+    for (auto const &entry : *config) {
+        if (entry.first != "model" && entry.first != "server") errors.push_back("unknown table `" + entry.first + "`");
+    }
+
+    if (config->contains("server")) {
+        auto server = config->get_table("server");
+        if (server) {
+            read_server_spec(server, server_spec, errors);
+        } else {
+            errors.push_back("`server` should be a table");
+        }
+    }
+
+    std::vector<ModelSpec> specs;
+    if (config->contains("model")) {
+        auto models = config->get_table_array("model");
+        if (models) {
+            for (auto const &model : *models) {
+                // every model starts from the defaults
+                ModelSpec spec;
+                read_model_spec(model, "[[model]] #" + std::to_string(specs.size() + 1), spec, errors);
+
+                for (auto const &other : specs) {
+                    if (other.name == spec.name && other.language_code == spec.language_code) {
+                        errors.push_back("model " + spec.name + " (" + spec.language_code + ") declared more than once");
+                    }
+                    // (the feature configs themselves are compared when a frontend is shared)
+                    if (!spec.feature_group.empty() && other.feature_group == spec.feature_group &&
+                        (other.feature_type != spec.feature_type || other.use_ivectors != spec.use_ivectors ||
+                         other.add_pitch != spec.add_pitch)) {
+                        errors.push_back("model " + spec.name + " (" + spec.language_code + ") has other features than model " +
+                                         other.name + " (" + other.language_code + ") of feature group `" + spec.feature_group + "`");
+                    }
+                }
+                specs.push_back(spec);
+            }
+        } else {
+            errors.push_back("`model` should be an array of tables ([[model]])");
+        }
+    }
+
+    // the model directories are checked concurrently (they may well be on
+    // network storage), reporting the missing artefacts of all of them
+    std::vector<std::future<std::vector<std::string>>> artefact_checks;
+    for (auto const &spec : specs) {
+        if (!spec.path.empty()) artefact_checks.push_back(std::async(std::launch::async, model_artefact_errors, spec));
+    }
+    for (auto &artefact_check : artefact_checks) {
+        const std::vector<std::string> artefact_errors = artefact_check.get();
+        errors.insert(errors.end(), artefact_errors.begin(), artefact_errors.end());
+    }
+
+    // the frontend of a feature group extracts the i-vectors of its first model
+    // for all of them, so they have to share the extractor (and its options)
+    std::map<std::string, std::pair<const ModelSpec*, std::map<std::string, std::string>>> group_extractors;
+    for (auto const &spec : specs) {
+        if (spec.feature_group.empty() || !spec.use_ivectors || spec.path.empty()) continue;
+
+        const std::map<std::string, std::string> options = ivector_extractor_options(spec);
+        auto it = group_extractors.find(spec.feature_group);
+        if (it == group_extractors.end()) {
+            group_extractors[spec.feature_group] = std::make_pair(&spec, options);
+        } else if (it->second.second != options) {
+            const ModelSpec &other = *it->second.first;
+            errors.push_back("model " + spec.name + " (" + spec.language_code + ") has another i-vector extractor than model " +
+                             other.name + " (" + other.language_code + ") of feature group `" + spec.feature_group + "`");
+        }
+    }
+
+    if (!errors.empty()) throw ConfigError(toml_path, errors);
+
+    model_specs.insert(model_specs.end(), specs.begin(), specs.end());
+}
+
+void parse_model_specs(const std::string &toml_path, std::vector<ModelSpec> &model_specs) {
+    ServerSpec server_spec;
+    parse_config(toml_path, model_specs, server_spec);
+}
+
+void parse_server_spec(const std::string &toml_path, ServerSpec &server_spec) {
+    std::vector<ModelSpec> model_specs;
+    parse_config(toml_path, model_specs, server_spec);
 }
 
 void string_join(const std::vector<std::string> &strings, std::string separator, std::string &output) {
     output.clear();
 
+    std::size_t length = 0;
+    for (auto const &s : strings) length += s.size() + separator.size();
+    output.reserve(length);
+
     for (auto i = 0; i < strings.size(); i++) {
         output += strings[i];
 
@@ -0,0 +1,24 @@
+// utils-mem.cpp - Memory Utilities Implementation
+
+// stl includes
+#include <fstream>
+
+// unix includes
+#include <unistd.h>
+
+// local includes
+#include "utils.hpp"
+
+
+namespace kaldiserve {
+
+std::size_t resident_memory() {
+    // second field of statm is the resident set size (in pages)
+    std::ifstream statm("/proc/self/statm");
+    std::size_t total_pages = 0, resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) return 0;
+
+    return resident_pages * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+} // namespace kaldiserve
\ No newline at end of file
@@ -0,0 +1,127 @@
+// utils-numa.cpp - NUMA Utilities Implementation
+
+// stl includes
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// unix includes
+#include <pthread.h>
+#include <sched.h>
+
+// local includes
+#include "utils.hpp"
+
+
+namespace kaldiserve {
+
+// parses a sysfs cpu list (e.g. "0-7,16-23") into cpu ids
+static std::vector<int> parse_cpu_list(const std::string &cpu_list) {
+    std::vector<int> cpus;
+    std::stringstream ss(cpu_list);
+    std::string range;
+
+    while (std::getline(ss, range, ',')) {
+        if (range.empty()) continue;
+
+        std::size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+// cpus belonging to each NUMA node, read once from sysfs. Machines (or
+// containers) without NUMA information are treated as a single node.
+static const std::vector<std::vector<int>> &numa_topology() {
+    static const std::vector<std::vector<int>> node_cpus = [] {
+        std::vector<std::vector<int>> nodes;
+
+        for (int node = 0;; node++) {
+            std::string node_dir = join_path("/sys/devices/system/node", "node" + std::to_string(node));
+            if (!exists(node_dir)) break;
+
+            std::ifstream cpu_list_file(join_path(node_dir, "cpulist"));
+            std::string cpu_list;
+            std::getline(cpu_list_file, cpu_list);
+
+            nodes.push_back(parse_cpu_list(cpu_list));
+        }
+
+        if (nodes.empty()) nodes.emplace_back();
+        return nodes;
+    }();
+    return node_cpus;
+}
+
+int numa_node_count() {
+    return numa_topology().size();
+}
+
+int current_numa_node() {
+    const int cpu = sched_getcpu();
+    const auto &nodes = numa_topology();
+
+    for (std::size_t node = 0; node < nodes.size(); node++) {
+        for (auto const &node_cpu : nodes[node]) {
+            if (node_cpu == cpu) return node;
+        }
+    }
+    return 0;
+}
+
+std::vector<int> numa_node_cpus(const int &node) {
+    const auto &nodes = numa_topology();
+    if (node < 0 || node >= nodes.size()) return std::vector<int>();
+    return nodes[node];
+}
+
+bool pin_thread_to_numa_node(const int &node) {
+    const auto &nodes = numa_topology();
+    if (node < 0 || node >= nodes.size() || nodes[node].empty()) return false;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto const &cpu : nodes[node]) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0;
+}
+
+bool pin_thread_to_cpu(const int &cpu) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0;
+}
+
+ScopedNumaPin::ScopedNumaPin(const int &node) {
+    if (node < 0 || numa_node_count() < 2) return;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) != 0) return;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &cpu_set)) previous_cpus_.push_back(cpu);
+    }
+    if (!pin_thread_to_numa_node(node)) previous_cpus_.clear();
+}
+
+ScopedNumaPin::~ScopedNumaPin() {
+    if (previous_cpus_.empty()) return;
+
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (auto const &cpu : previous_cpus_) {
+        CPU_SET(cpu, &cpu_set);
+    }
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+}
+
+} // namespace kaldiserve
\ No newline at end of file
@@ -0,0 +1,255 @@
+// wav-parser.cpp - WAV Stream Parser Implementation
+
+// stl includes
+#include <algorithm>
+#include <cstring>
+
+// local includes
+#include "config.hpp"
+#include "wav.hpp"
+
+
+namespace kaldiserve {
+
+// wave format tags
+static const uint16_t WAVE_FORMAT_PCM = 0x0001;
+static const uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+static const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+
+// little endian readers (independent of the host byte order)
+static inline uint16_t read_uint16(const char *data) noexcept {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    return uint16_t(bytes[0]) | uint16_t(bytes[1]) << 8;
+}
+
+static inline uint32_t read_uint32(const char *data) noexcept {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    return uint32_t(bytes[0]) | uint32_t(bytes[1]) << 8 | uint32_t(bytes[2]) << 16 | uint32_t(bytes[3]) << 24;
+}
+
+// tells whether a chunk starts with a (re-sent) RIFF header, i.e. with "RIFF",
+// "WAVE" and a valid fmt sub-chunk. "RIFF" alone is no more than two valid
+// 16-bit samples of a headerless stream.
+static bool starts_with_header(const char *data, const std::size_t &size) noexcept {
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) return false;
+
+    std::size_t offset = 12;
+    while (offset + 8 <= size) {
+        const char *chunk_id = data + offset;
+        const std::size_t chunk_size = read_uint32(data + offset + 4);
+        offset += 8;
+
+        if (std::memcmp(chunk_id, "data", 4) == 0) return false;
+
+        if (std::memcmp(chunk_id, "fmt ", 4) == 0) {
+            if (chunk_size < 16 || offset + 16 > size) return false;
+
+            const char *fmt = data + offset;
+            const uint16_t format_tag = read_uint16(fmt);
+            const uint16_t num_channels = read_uint16(fmt + 2);
+            const uint16_t block_align = read_uint16(fmt + 12);
+            const uint16_t bits_per_sample = read_uint16(fmt + 14);
+            return (format_tag == WAVE_FORMAT_PCM || format_tag == WAVE_FORMAT_IEEE_FLOAT || format_tag == WAVE_FORMAT_EXTENSIBLE) &&
+                   (bits_per_sample == 16 || bits_per_sample == 32) &&
+                   num_channels > 0 && block_align == num_channels * (bits_per_sample / 8);
+        }
+
+        // chunks are word aligned
+        offset += chunk_size + (chunk_size & 1);
+    }
+    return false;
+}
+
+WavStreamParser::WavStreamParser() noexcept {
+    reset();
+}
+
+void WavStreamParser::reset() noexcept {
+    has_header_ = false;
+    samp_freq_ = 0;
+    num_channels_ = 0;
+    sample_width_ = 0;
+    block_align_ = 0;
+    sample_format_ = PCM_16;
+    in_header_ = false;
+    pending_.clear();
+}
+
+void WavStreamParser::parse(const char *data, std::size_t size,
+                            std::vector<kaldi::BaseFloat> &samples,
+                            const std::size_t &channel) {
+    samples.clear();
+
+    // the first chunk, or a chunk starting with a whole header at a sample block
+    // boundary, (re)starts the stream
+    if (!in_header_ && (!has_header_ || (pending_.empty() && starts_with_header(data, size)))) {
+        has_header_ = false;
+        in_header_ = true;
+        pending_.clear();
+    }
+
+    if (in_header_) {
+        pending_.insert(pending_.end(), data, data + size);
+
+        std::size_t header_size;
+        if (!parse_header_(pending_.data(), pending_.size(), header_size)) return;
+        in_header_ = false;
+
+        if (channel >= num_channels_) {
+            KALDI_ERR << "WavStreamParser: channel " << channel << " not in a "
+                      << num_channels_ << " channel stream";
+        }
+
+        // audio data that came along with the header
+        std::vector<char> header_data;
+        header_data.swap(pending_);
+        read_samples_(header_data.data() + header_size, header_data.size() - header_size, samples, channel);
+        return;
+    }
+
+    read_samples_(data, size, samples, channel);
+}
+
+bool WavStreamParser::parse_header_(const char *data, const std::size_t &size, std::size_t &header_size) {
+    if (std::memcmp(data, "RIFF", std::min<std::size_t>(size, 4)) != 0)
+        KALDI_ERR << "WavStreamParser: stream does not start with a RIFF header";
+
+    if (size < 12) return false;
+
+    if (std::memcmp(data + 8, "WAVE", 4) != 0)
+        KALDI_ERR << "WavStreamParser: expected WAVE in the RIFF header";
+
+    bool has_format = false;
+    std::size_t offset = 12;
+
+    // walk the sub-chunks up to the (unbounded) data chunk
+    while (offset + 8 <= size) {
+        const char *chunk_id = data + offset;
+        const std::size_t chunk_size = read_uint32(data + offset + 4);
+        offset += 8;
+
+        if (std::memcmp(chunk_id, "data", 4) == 0) {
+            if (!has_format)
+                KALDI_ERR << "WavStreamParser: data chunk before the fmt chunk";
+            // the data size is not relied upon, streams often leave it unset
+            header_size = offset;
+            has_header_ = true;
+            return true;
+        }
+
+        if (std::memcmp(chunk_id, "fmt ", 4) == 0) {
+            if (offset + chunk_size > size) return false;
+            if (chunk_size < 16)
+                KALDI_ERR << "WavStreamParser: malformed fmt chunk";
+
+            const char *fmt = data + offset;
+            uint16_t format_tag = read_uint16(fmt);
+            const uint16_t num_channels = read_uint16(fmt + 2);
+            const uint32_t samp_freq = read_uint32(fmt + 4);
+            const uint16_t block_align = read_uint16(fmt + 12);
+            const uint16_t bits_per_sample = read_uint16(fmt + 14);
+
+            // the sub format guid starts with the actual format tag
+            if (format_tag == WAVE_FORMAT_EXTENSIBLE) {
+                if (chunk_size < 40)
+                    KALDI_ERR << "WavStreamParser: malformed extensible fmt chunk";
+                format_tag = read_uint16(fmt + 24);
+            }
+
+            if (format_tag == WAVE_FORMAT_PCM && bits_per_sample == 16) {
+                sample_format_ = PCM_16;
+            } else if (format_tag == WAVE_FORMAT_IEEE_FLOAT && bits_per_sample == 32) {
+                sample_format_ = FLOAT_32;
+            } else {
+                KALDI_ERR << "WavStreamParser: unsupported format " << format_tag << " with "
+                          << bits_per_sample << " bits per sample (only 16-bit pcm and 32-bit float)";
+            }
+
+            if (num_channels == 0 || block_align != num_channels * (bits_per_sample / 8))
+                KALDI_ERR << "WavStreamParser: inconsistent block align " << block_align
+                          << " for " << num_channels << " channels";
+
+            samp_freq_ = samp_freq;
+            num_channels_ = num_channels;
+            sample_width_ = bits_per_sample / 8;
+            block_align_ = block_align;
+            has_format = true;
+        }
+
+        // chunks are word aligned
+        offset += chunk_size + (chunk_size & 1);
+    }
+    return false;
+}
+
+void WavStreamParser::read_samples_(const char *data, std::size_t size,
+                                    std::vector<kaldi::BaseFloat> &samples,
+                                    const std::size_t &channel) {
+    const std::size_t channel_offset = channel * sample_width_;
+
+    // complete the block split across the previous chunk
+    if (!pending_.empty()) {
+        const std::size_t n_bytes = std::min(block_align_ - pending_.size(), size);
+        pending_.insert(pending_.end(), data, data + n_bytes);
+        data += n_bytes;
+        size -= n_bytes;
+
+        if (pending_.size() < block_align_) return;
+        samples.push_back(sample_(pending_.data() + channel_offset));
+        pending_.clear();
+    }
+
+    const std::size_t n_blocks = size / block_align_;
+    samples.reserve(samples.size() + n_blocks);
+    for (std::size_t i = 0; i < n_blocks; i++) {
+        samples.push_back(sample_(data + i * block_align_ + channel_offset));
+    }
+
+    // keep the incomplete trailing block for the next chunk
+    pending_.assign(data + n_blocks * block_align_, data + size);
+}
+
+void WavStreamParser::write(std::ostream &os) const {
+    kaldi::WriteToken(os, true, "<WavStream>");
+    kaldi::WriteBasicType(os, true, has_header_);
+    kaldi::WriteBasicType(os, true, samp_freq_);
+    kaldi::WriteBasicType(os, true, static_cast<int32>(num_channels_));
+    kaldi::WriteBasicType(os, true, static_cast<int32>(sample_width_));
+    kaldi::WriteBasicType(os, true, static_cast<int32>(block_align_));
+    kaldi::WriteBasicType(os, true, static_cast<int32>(sample_format_));
+    kaldi::WriteBasicType(os, true, in_header_);
+    kaldi::WriteIntegerVector(os, true, pending_);
+    kaldi::WriteToken(os, true, "</WavStream>");
+}
+
+void WavStreamParser::read(std::istream &is) {
+    int32 num_channels, sample_width, block_align, sample_format;
+
+    kaldi::ExpectToken(is, true, "<WavStream>");
+    kaldi::ReadBasicType(is, true, &has_header_);
+    kaldi::ReadBasicType(is, true, &samp_freq_);
+    kaldi::ReadBasicType(is, true, &num_channels);
+    kaldi::ReadBasicType(is, true, &sample_width);
+    kaldi::ReadBasicType(is, true, &block_align);
+    kaldi::ReadBasicType(is, true, &sample_format);
+    kaldi::ReadBasicType(is, true, &in_header_);
+    kaldi::ReadIntegerVector(is, true, &pending_);
+    kaldi::ExpectToken(is, true, "</WavStream>");
+
+    num_channels_ = num_channels;
+    sample_width_ = sample_width;
+    block_align_ = block_align;
+    sample_format_ = static_cast<SampleFormat>(sample_format);
+}
+
+kaldi::BaseFloat WavStreamParser::sample_(const char *data) const noexcept {
+    if (sample_format_ == PCM_16) {
+        return int16_t(read_uint16(data));
+    }
+    const uint32_t bits = read_uint32(data);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value * 32768.0f;
+}
+
+} // namespace kaldiserve
\ No newline at end of file
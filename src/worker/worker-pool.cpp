@@ -0,0 +1,135 @@
+// worker-pool.cpp - Decode Worker Pool Implementation
+
+// local includes
+#include "config.hpp"
+#include "utils.hpp"
+#include "worker.hpp"
+
+
+namespace kaldiserve {
+
+// scheduling state of the pool worker running on this thread
+static thread_local WorkerPool *worker_pool = nullptr;
+static thread_local std::size_t worker_lane = 0;
+static thread_local Priority worker_priority = REALTIME;
+
+WorkerPool::WorkerPool(const std::size_t &n_workers, const bool &pin_workers)
+    : n_lanes_(pin_workers ? numa_node_count() : 1), queues_(N_PRIORITIES * n_lanes_) {
+    const int n_nodes = n_lanes_;
+    const int n_cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    for (std::size_t i = 0; i < n_workers; i++) {
+        const int node = i % n_nodes;
+
+        workers_.emplace_back([this, i, node, n_nodes, n_cpus, pin_workers]() {
+            if (pin_workers) {
+                // workers round robin over the nodes, then over the node's cpus
+                const std::vector<int> cpus = numa_node_cpus(node);
+                const int cpu = cpus.empty() ? i % n_cpus : cpus[(i / n_nodes) % cpus.size()];
+                pin_thread_to_cpu(cpu);
+            }
+            work_(node);
+        });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    std::unique_lock<std::mutex> mlock(mutex_);
+    stopped_ = true;
+    mlock.unlock();
+    cond_.notify_all();
+
+    for (auto &worker : workers_) worker.join();
+}
+
+std::future<void> WorkerPool::submit(std::function<void()> task,
+                                     const int &numa_node,
+                                     const Priority &priority) {
+    // the thread running the task is kept on the node holding the task's
+    // model for the task's duration only (pinned workers are on a node
+    // already, but may pick up tasks of other nodes' lanes)
+    if (numa_node >= 0 && numa_node_count() > 1) {
+        task = [task, numa_node]() {
+            ScopedNumaPin pin(numa_node);
+            task();
+        };
+    }
+
+    std::packaged_task<void()> packaged_task(std::move(task));
+    std::future<void> future = packaged_task.get_future();
+
+    if (workers_.empty()) {
+        packaged_task();
+        return future;
+    }
+
+    const std::size_t lane = numa_node < 0 ? 0 : numa_node % n_lanes_;
+
+    std::unique_lock<std::mutex> mlock(mutex_);
+    queue_(priority, lane).push(std::move(packaged_task));
+    mlock.unlock();
+    cond_.notify_one();
+
+    return future;
+}
+
+void WorkerPool::yield() {
+    WorkerPool *pool = worker_pool;
+    // realtime tasks are never preempted
+    if (pool == nullptr || worker_priority == REALTIME) return;
+
+    std::packaged_task<void()> task;
+    Priority priority;
+    while (true) {
+        std::unique_lock<std::mutex> mlock(pool->mutex_);
+        if (!pool->try_pop_(worker_lane, REALTIME, task, priority)) return;
+        mlock.unlock();
+
+        pool->run_task_(task, priority);
+    }
+}
+
+void WorkerPool::work_(const std::size_t &lane) {
+    worker_pool = this;
+    worker_lane = lane;
+
+    std::packaged_task<void()> task;
+    Priority priority;
+    while (pop_(lane, task, priority)) {
+        run_task_(task, priority);
+    }
+}
+
+void WorkerPool::run_task_(std::packaged_task<void()> &task, const Priority &priority) {
+    const Priority outer_priority = worker_priority;
+    worker_priority = priority;
+    task();
+    worker_priority = outer_priority;
+}
+
+bool WorkerPool::pop_(const std::size_t &lane, std::packaged_task<void()> &task, Priority &priority) {
+    std::unique_lock<std::mutex> mlock(mutex_);
+    while (!try_pop_(lane, BATCH, task, priority)) {
+        if (stopped_) return false;
+        cond_.wait(mlock);
+    }
+    return true;
+}
+
+bool WorkerPool::try_pop_(const std::size_t &lane, const Priority &lowest,
+                          std::packaged_task<void()> &task, Priority &priority) {
+    for (int p = REALTIME; p <= lowest; p++) {
+        for (std::size_t i = 0; i < n_lanes_; i++) {
+            auto &queue = queue_(Priority(p), (lane + i) % n_lanes_);
+            if (!queue.empty()) {
+                task = std::move(queue.front());
+                queue.pop();
+                priority = Priority(p);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+} // namespace kaldiserve
\ No newline at end of file